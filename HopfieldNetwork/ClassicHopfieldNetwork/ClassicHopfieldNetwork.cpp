@@ -1,9 +1,18 @@
 #include "ClassicHopfieldNetwork.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
-#include <random>
 
 namespace abc {
+std::uint64_t ClassicHopfieldNetwork::nextVersion() {
+  // parte da 1: un workspace nuovo (versione 0) non ha campi validi
+  static std::atomic<std::uint64_t> counter{0};
+  return ++counter;
+}
+
 void ClassicHopfieldNetwork::checkPatternDimension(
     const std::vector<int>& pattern) const {
   if (weightMatrix_.size() !=
@@ -15,7 +24,7 @@ void ClassicHopfieldNetwork::checkPatternDimension(
 }
 
 ClassicHopfieldNetwork::ClassicHopfieldNetwork(std::size_t dimension)
-    : weightMatrix_(dimension, dimension, 0) {
+    : weightMatrix_(dimension) {
   if (dimension == 0) {
     throw std::runtime_error(
         "Invalid pattern dimension, it must be greater than 0");
@@ -23,126 +32,361 @@ ClassicHopfieldNetwork::ClassicHopfieldNetwork(std::size_t dimension)
   weightMatrix_.setFixedSize(true);
 }
 
-void ClassicHopfieldNetwork::learnPattern(const std::vector<int>& pattern) {
-  checkPatternDimension(pattern);
-  for (unsigned int i = 0; i < pattern.size(); ++i) {
-    for (unsigned int j = i; j < pattern.size(); ++j) {
-      if (i != j) {
-        weightMatrix_.setElement(
-            i, j,
-            weightMatrix_.getElement(i, j) +
-                static_cast<double>(pattern[i] * pattern[j]) /
-                    static_cast<double>(pattern.size()));
-        weightMatrix_.setElement(j, i, weightMatrix_.getElement(i, j));
+void ClassicHopfieldNetwork::prepareLearning(
+    std::span<const std::vector<int>> patterns) {
+  // tutti i pattern si controllano prima di toccare i pesi: un errore lascia
+  // la rete com'era
+  for (const auto& pattern : patterns) {
+    checkPatternDimension(pattern);
+    for (const int value : pattern) {
+      if (value != 1 && value != -1) {
+        throw std::runtime_error("Patterns must contain only +1 and -1!");
       }
     }
   }
+  // pesi mappati da un file: si copiano prima di modificarli
+  weightMatrix_.detach();
+  version_ = nextVersion();
 }
 
-void ClassicHopfieldNetwork::save(const std::string& filepath) const {
-  weightMatrix_.saveOnFile(filepath);
+void ClassicHopfieldNetwork::learnPattern(const std::vector<int>& pattern) {
+  prepareLearning(std::span<const std::vector<int>>(&pattern, 1));
+  const std::size_t n{pattern.size()};
+  const double norm{static_cast<double>(n)};
+  // la matrice e' simmetrica: basta aggiornare il triangolo superiore
+  for (std::size_t i = 0; i + 1 < n; ++i) {
+    const auto row = weightMatrix_.upperRow(i);
+    const int* tail = pattern.data() + i + 1;
+    const double si = pattern[i] / norm;
+    for (std::size_t k = 0; k < row.size(); ++k) {
+      row[k] += si * tail[k];
+    }
+  }
+}
+
+void ClassicHopfieldNetwork::learnPatterns(
+    std::span<const std::vector<int>> patterns, unsigned int nThreads) {
+  prepareLearning(patterns);
+  const std::size_t n{weightMatrix_.size()};
+  const std::size_t k{patterns.size()};
+
+  // X e' salvata per neuroni: stacked[i * k + p] = patterns[p][i]
+  std::vector<std::int8_t> stacked(n * k);
+  for (std::size_t p = 0; p < k; ++p) {
+    for (std::size_t i = 0; i < n; ++i) {
+      stacked[i * k + p] = static_cast<std::int8_t>(patterns[p][i]);
+    }
+  }
+
+  // la diagonale non e' salvata: resta nulla per costruzione
+  weightMatrix_.rankUpdate(stacked, k, 1.0 / static_cast<double>(n), nThreads);
+}
+
+void ClassicHopfieldNetwork::save(const std::string& filepath,
+                                 FileFormat format) const {
+  if (format == FileFormat::Binary) {
+    weightMatrix_.saveOnBinaryFile(filepath);
+  } else {
+    weightMatrix_.saveOnFile(filepath);
+  }
 }
 
 void ClassicHopfieldNetwork::loadMemory(const std::string& filepath) {
-  weightMatrix_.loadMatrixFromFile(filepath);
+  version_ = nextVersion();
+  // i file binari vengono mappati in memoria, senza parsing
+  if (isBinaryMatrixFile(filepath)) {
+    weightMatrix_.mapBinaryFile(filepath);
+  } else {
+    weightMatrix_.loadMatrixFromFile(filepath);
+  }
 }
 
-const Matrix<double>& ClassicHopfieldNetwork::getMatrix() const {
+const SymmetricMatrix<double>& ClassicHopfieldNetwork::getMatrix() const {
   return weightMatrix_;
 }
 
-bool ClassicHopfieldNetwork::restorePattern(std::vector<int>& pattern) {
+void ClassicHopfieldNetwork::prepareLocalField(const std::vector<int>& pattern,
+                                               RecallWorkspace& work) const {
+  // la cache vale solo se i pesi non sono cambiati e si riparte dallo stato
+  // lasciato dalla chiamata precedente
+  if (work.fieldVersion != version_ || pattern != work.originalPattern) {
+    work.localField.resize(pattern.size());
+    weightMatrix_.multiply(pattern, work.localField);
+    work.fieldVersion = version_;
+  }
+  work.flipped.clear();
+  work.flipDeltas.clear();
+}
+
+void ClassicHopfieldNetwork::flipNeuron(std::size_t i,
+                                        std::vector<int>& pattern,
+                                        RecallWorkspace& work) const {
+  // h_j += W_ij * (s_i' - s_i) = -2 s_i W_ij. Subito per j > i (neuroni
+  // ancora da visitare, riga impacchettata i); per j < i a fine sweep
+  const double delta = -2.0 * pattern[i];
+  weightMatrix_.addRowAbove(i, delta, work.localField);
+  pattern[i] = -pattern[i];
+  work.flipped.push_back(i);
+  work.flipDeltas.push_back(delta);
+}
+
+void ClassicHopfieldNetwork::commitFlips(RecallWorkspace& work) const {
+  weightMatrix_.addColumnsAbove(work.flipped, work.flipDeltas,
+                                work.localField);
+}
+
+bool ClassicHopfieldNetwork::restoreSynchronous(std::vector<int>& pattern,
+                                                unsigned int nThreads,
+                                                RecallWorkspace& work) const {
+  // s' = sign(W s) per tutti i neuroni insieme: i campi si calcolano dallo
+  // stesso stato, quindi il prodotto si divide fra i thread
+  if (!work.pool || work.pool->size() != resolveThreadCount(nThreads)) {
+    work.pool = std::make_shared<ThreadPool>(nThreads);
+  }
+  work.nextPattern.resize(pattern.size());
+  work.localField.resize(pattern.size());
+  weightMatrix_.multiplySign(pattern, work.localField, work.nextPattern,
+                             *work.pool, work.signWorkspace);
+  // i campi sono quelli dello stato vecchio: non valgono come cache
+  work.fieldVersion = 0;
+
+  work.flipped.clear();
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    if (work.nextPattern[i] != pattern[i]) {
+      work.flipped.push_back(i);
+    }
+  }
+  // con pesi simmetrici la dinamica sincrona finisce in un punto fisso o in
+  // un ciclo di periodo 2: s(t+1) == s(t-1)
+  const bool continues{pattern == work.originalPattern};
+  work.oscillating = !work.flipped.empty() && continues &&
+                     work.nextPattern == work.previousPattern;
+  work.previousPattern = pattern;
+  pattern.swap(work.nextPattern);
+  work.originalPattern = pattern;
+  return work.flipped.empty() || work.oscillating;
+}
+
+bool ClassicHopfieldNetwork::restorePattern(std::vector<int>& pattern,
+                                            RecallWorkspace& work,
+                                            UpdateMode mode,
+                                            unsigned int nThreads) const {
   checkPatternDimension(pattern);
-  std::cout << '#' << std::flush;
-  for (unsigned int i = 0; i < pattern.size(); ++i) {
-    double signSum = 0;
-    for (unsigned int j = 0; j < pattern.size(); ++j) {
-      signSum += weightMatrix_.getElement(i, j) * pattern[j];
+  if (progress_) {
+    std::cout << '#' << std::flush;
+  }
+  work.oscillating = false;
+  if (mode == UpdateMode::Synchronous) {
+    return restoreSynchronous(pattern, nThreads, work);
+  }
+  // costo O(N) piu' O(N) per ogni neurone che cambia: gli sweep finali,
+  // quasi senza cambiamenti, non rileggono tutta la matrice
+  prepareLocalField(pattern, work);
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    const int newState = work.localField[i] > 0.0 ? 1 : -1;
+    if (newState != pattern[i]) {
+      flipNeuron(i, pattern, work);
     }
-    pattern[i] = signSum > 0.0 ? 1 : -1;
   }
-  if (originalPattern_ == pattern) {
+  commitFlips(work);
+  if (work.originalPattern == pattern) {
     return true;
   }
-  originalPattern_ = pattern;
+  work.originalPattern = pattern;
   return false;
 }
 
-double ClassicHopfieldNetwork::energyPerElement(
-    size_t i, const std::vector<int>& pattern) const {
-  double energy = {0.0};
-  for (unsigned int k = 0; k < pattern.size(); ++k) {
-    energy += static_cast<double>((-0.5) * weightMatrix_.getElement(k, i) *
-                                  pattern[i] * pattern[k]);
+std::vector<bool> ClassicHopfieldNetwork::restoreBatch(
+    std::span<std::vector<int>> patterns, UpdateMode mode,
+    std::size_t maxSweeps, unsigned int nThreads,
+    std::span<std::size_t> sweeps) const {
+  for (const auto& pattern : patterns) {
+    checkPatternDimension(pattern);
+  }
+  if (!sweeps.empty() && sweeps.size() != patterns.size()) {
+    throw std::runtime_error("matrix and pattern sizes do not match!");
+  }
+  std::fill(sweeps.begin(), sweeps.end(), std::size_t{0});
+  // non servono piu' thread che pattern
+  ThreadPool pool(static_cast<unsigned int>(std::clamp<std::size_t>(
+      patterns.size(), 1, resolveThreadCount(nThreads))));
+  const std::size_t n{weightMatrix_.size()};
+  std::vector<bool> converged(patterns.size(), false);
+
+  // stati e campi N x B: la riga i contiene il neurone i dei pattern ancora
+  // attivi, index[q] dice a quale pattern corrisponde la colonna q. Gli
+  // stati sono +-1 e stanno in un byte
+  std::size_t b{patterns.size()};
+  std::vector<std::size_t> index(b);
+  std::vector<std::int8_t> states(n * b);
+  for (std::size_t q = 0; q < b; ++q) {
+    index[q] = q;
+    for (std::size_t i = 0; i < n; ++i) {
+      states[i * b + q] = static_cast<std::int8_t>(patterns[q][i]);
+    }
   }
+  std::vector<double> fields(n * b);
+  std::vector<std::int8_t> previous;  // solo Synchronous
+  std::vector<double> deltas;
+  std::vector<std::size_t> flipped;
+  std::vector<char> keep;
 
-  return energy;
+  // riporta nei pattern gli stati delle colonne che escono dal blocco
+  auto retire = [&]() {
+    for (std::size_t q = 0; q < b; ++q) {
+      if (!keep[q]) {
+        for (std::size_t i = 0; i < n; ++i) {
+          patterns[index[q]][i] = static_cast<int>(states[i * b + q]);
+        }
+      }
+    }
+    keepColumns(index, b, keep);
+    keepColumns(states, b, keep);
+    keepColumns(fields, b, keep);
+    if (!previous.empty()) {
+      keepColumns(previous, b, keep);
+    }
+    b = index.size();
+  };
+
+  if (mode == UpdateMode::Asynchronous && b > 0) {
+    weightMatrix_.multiplyBatch(states, b, fields, pool);
+  }
+  for (std::size_t sweep = 0; sweep < maxSweeps && b > 0; ++sweep) {
+    keep.assign(b, 0);
+    if (mode == UpdateMode::Synchronous) {
+      weightMatrix_.multiplyBatch(states, b, fields, pool);
+      std::vector<std::int8_t> next(n * b);
+      for (std::size_t k = 0; k < n * b; ++k) {
+        next[k] = fields[k] > 0.0 ? 1 : -1;
+        keep[k % b] |= next[k] != states[k];
+      }
+      for (std::size_t q = 0; q < b; ++q) {
+        converged[index[q]] = !keep[q];
+        if (!sweeps.empty()) {
+          sweeps[index[q]] = sweep + 1;
+        }
+      }
+      // ciclo di periodo 2: lo stato nuovo e' quello di due passi prima
+      if (!previous.empty()) {
+        std::vector<char> cycle(b, 1);
+        for (std::size_t k = 0; k < n * b; ++k) {
+          cycle[k % b] &= next[k] == previous[k];
+        }
+        for (std::size_t q = 0; q < b; ++q) {
+          keep[q] &= !cycle[q];
+        }
+      }
+      previous.swap(states);
+      states.swap(next);
+    } else {
+      // sweep asincrono su tutte le colonne: i flip del neurone i aggiornano
+      // subito i campi dei neuroni j > i (una riga di W per tutti i pattern),
+      // quelli dei neuroni j < i a fine sweep
+      flipped.clear();
+      deltas.clear();
+      std::vector<double> delta(b);
+      for (std::size_t i = 0; i < n; ++i) {
+        bool any{false};
+        std::int8_t* s = states.data() + i * b;
+        const double* h = fields.data() + i * b;
+        for (std::size_t q = 0; q < b; ++q) {
+          const std::int8_t next{h[q] > 0.0 ? std::int8_t{1} : std::int8_t{-1}};
+          delta[q] = next - s[q];
+          if (next != s[q]) {
+            s[q] = next;
+            keep[q] = 1;
+            any = true;
+          }
+        }
+        if (any) {
+          weightMatrix_.addRowAboveBatch(i, delta, fields);
+          flipped.push_back(i);
+          deltas.insert(deltas.end(), delta.begin(), delta.end());
+        }
+      }
+      weightMatrix_.addColumnsAboveBatch(flipped, deltas, b, fields);
+      for (std::size_t q = 0; q < b; ++q) {
+        converged[index[q]] = !keep[q];
+        if (!sweeps.empty()) {
+          sweeps[index[q]] = sweep + 1;
+        }
+      }
+    }
+    retire();
+  }
+  // chi ha finito gli sweep senza convergere riceve comunque l'ultimo stato
+  keep.assign(b, 0);
+  retire();
+  return converged;
 }
 
 double ClassicHopfieldNetwork::totalEnergy(
     const std::vector<int>& pattern) const {
-  double totalEnergy{0.0};
-
-  for (size_t i{0}; i < pattern.size(); ++i) {
-    totalEnergy += energyPerElement(i, pattern);
-  }
-
-  return totalEnergy;
+  checkPatternDimension(pattern);
+  // -1/2 s^T W s = -sum_{i<j} W_ij s_i s_j
+  return -weightMatrix_.quadraticForm(pattern);
 }
 
-bool ClassicHopfieldNetwork::probability(double dE, double temp) const {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<> distrib(0.0, 1.0);
-
-  long double prob = std::exp((-std::abs(dE) / (temp)));
-  double r = distrib(gen);
-
-  return r < prob;
+bool ClassicHopfieldNetwork::probability(double dE, double temp,
+                                         UniformStream& uniform) const {
+  return acceptMove(dE, Temperature{temp, 1.0 / temp}, uniform);
 }
 
-double ClassicHopfieldNetwork::CoolingSchedule(int iter) const {
-  double temp;
-  double temp_0 = 50;
-  if (iter == 0) {
-    temp = temp_0;
-    return temp;
+bool ClassicHopfieldNetwork::acceptMove(double dE, const Temperature& temp,
+                                        UniformStream& uniform) const {
+  // a T = 0 discesa pura, senza esponenziali: il candidato non alza mai
+  // l'energia, e passa solo se la abbassa davvero
+  if (temp.value <= 0.0) {
+    return dE != 0.0;
   }
+  // le uniformi arrivano a blocchi dallo stream, senza chiamate di sistema
+  const double prob = std::exp(-std::abs(dE) * temp.inverse);
+  return uniform() < prob;
+}
 
-  // temp = static_cast<float>(temp_0 * std::pow(0.8, iter));
-  temp = static_cast<float>(temp_0 * (1 / std::log(2 + iter)));
-
-  if (temp < 0.01) {
-    temp = 0.0;
-  }
-  return temp;
+double ClassicHopfieldNetwork::CoolingSchedule(int iter) const {
+  return cooling_.at(iter).value;
 }
 
 bool ClassicHopfieldNetwork::restorePattern_withAnnealing(
-    std::vector<int>& pattern, int n) {
+    std::vector<int>& pattern, int n, RecallWorkspace& work,
+    UniformStream& uniform) const {
   checkPatternDimension(pattern);
-  std::cout << '#' << std::flush;
-
-  for (unsigned int i = 0; i < pattern.size(); ++i) {
-    double signSum = 0;
-    for (unsigned int j = 0; j < pattern.size(); ++j) {
-      signSum += weightMatrix_.getElement(i, j) * pattern[j];
-    }
+  if (progress_) {
+    std::cout << '#' << std::flush;
+  }
 
-    double e0 = energyPerElement(i, pattern);
-    int candidate = signSum > 0.0 ? 1 : -1;
-    pattern[i] = candidate;
-    double dE = energyPerElement(i, pattern) - e0;
-    if (probability(dE, CoolingSchedule(n))) {
-      pattern[i] = candidate;
-    } else {
-      pattern[i] = -candidate;
+  // stessi campi locali di restorePattern: la variazione di energia del
+  // neurone i si ottiene in O(1) da h_i, e la temperatura si calcola una
+  // volta per sweep
+  prepareLocalField(pattern, work);
+  // la corsa adattiva riparte solo qui, al primo sweep (o con un workspace
+  // nuovo), da una copia della politica della rete
+  if (n == 0 || !work.cooling) {
+    work.cooling = cooling_;
+    work.cooling->reset();
+  }
+  const Temperature temp = work.cooling->at(n);
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    const int candidate = work.localField[i] > 0.0 ? 1 : -1;
+    if (candidate != pattern[i]) {
+      // energyPerElement(i, s') - energyPerElement(i, s) con s'_i = -s_i:
+      // -1/2 h_i (s'_i - s_i) = s_i h_i (a candidate == s_i, dE = 0 e la
+      // mossa e' sempre accettata)
+      const double dE = pattern[i] * work.localField[i];
+      if (acceptMove(dE, temp, uniform)) {
+        flipNeuron(i, pattern, work);
+      }
     }
   }
-  if (originalPattern_ == pattern) {
+  commitFlips(work);
+  work.cooling->observe(static_cast<double>(work.flipped.size()) /
+                        static_cast<double>(pattern.size()));
+  if (work.originalPattern == pattern) {
     return true;
   }
-  originalPattern_ = pattern;
+  work.originalPattern = pattern;
   return false;
 }
 }  // namespace abc
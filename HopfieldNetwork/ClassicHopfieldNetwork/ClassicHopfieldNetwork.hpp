@@ -1,17 +1,72 @@
 #ifndef HOPFIELDNEURALNETWORK_CLASSICHOPFIELDNETWORK_H
 #define HOPFIELDNEURALNETWORK_CLASSICHOPFIELDNETWORK_H
 
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "../Matrix/CoolingSchedule.hpp"
 #include "../Matrix/Matrix.hpp"
+#include "../Matrix/Parallel.hpp"
+#include "../Matrix/Random.hpp"
+#include "../Matrix/SymmetricMatrix.hpp"
 
 namespace abc {
+// Asynchronous: un neurone alla volta, ognuno vede i cambiamenti dei
+// precedenti (converge sempre). Synchronous (Little): tutti i campi dallo
+// stesso stato e poi tutti i segni insieme, in parallelo; puo' oscillare fra
+// due stati
+enum class UpdateMode { Asynchronous, Synchronous };
+
 class ClassicHopfieldNetwork {
+ public:
+  // stato di un recupero, mantenuto fra uno sweep e l'altro: la rete resta
+  // const, e per recuperare in parallelo basta un workspace per thread
+  struct RecallWorkspace {
+    std::vector<int> originalPattern;
+    // cache dei campi locali h = W s per lo stato originalPattern, valida
+    // finche' i pesi hanno ancora la versione fieldVersion (0 = nessuna)
+    std::vector<double> localField;
+    std::uint64_t fieldVersion{0};
+    std::vector<std::size_t> flipped;  // neuroni cambiati nello sweep corrente
+    std::vector<double> flipDeltas;
+
+    // aggiornamento sincrono: stato prima di originalPattern (per riconoscere
+    // i cicli di periodo 2), segni nuovi e thread riusati fra gli sweep
+    std::vector<int> previousPattern;
+    std::vector<int> nextPattern;
+    bool oscillating{false};
+    std::shared_ptr<ThreadPool> pool;
+    SymmetricMatrix<double>::SignWorkspace signWorkspace;
+    // copia della politica della rete, ripartita al primo sweep
+    // dell'annealing
+    std::optional<Cooling> cooling;
+  };
+
  private:
-  Matrix<double> weightMatrix_;
-  std::vector<int> originalPattern_;
+  SymmetricMatrix<double> weightMatrix_;  // solo il triangolo superiore
+  // cambia a ogni modifica dei pesi, unica fra tutte le reti: i campi in
+  // cache in un workspace valgono solo con la stessa versione
+  std::uint64_t version_{nextVersion()};
+  bool progress_{true};
+  Cooling cooling_{50.0};
+  // workspace dei metodi di recupero senza workspace esplicito
+  RecallWorkspace workspace_;
 
+  static std::uint64_t nextVersion();
   void checkPatternDimension(
       const std::vector<int>& pattern) const;  // class invariant
-  double energyPerElement(size_t i, const std::vector<int>& pattern) const;
+  // controlli e preparazione comuni a learnPattern e learnPatterns
+  void prepareLearning(std::span<const std::vector<int>> patterns);
+  void prepareLocalField(const std::vector<int>& pattern,
+                         RecallWorkspace& work) const;
+  void flipNeuron(std::size_t i, std::vector<int>& pattern,
+                  RecallWorkspace& work) const;
+  void commitFlips(RecallWorkspace& work) const;
+  bool restoreSynchronous(std::vector<int>& pattern, unsigned int nThreads,
+                          RecallWorkspace& work) const;
+  bool acceptMove(double dE, const Temperature& temp,
+                  UniformStream& uniform) const;
 
  public:
   // costructor
@@ -20,22 +75,76 @@ class ClassicHopfieldNetwork {
 
   // working with memory
   void learnPattern(const std::vector<int>& pattern);
-  void save(const std::string& filepath) const;
+  // apprendimento di Hebb di piu' pattern insieme: W += X X^T / N, con X
+  // matrice N x P dei pattern affiancati. nThreads = 0 usa tutti i core
+  void learnPatterns(std::span<const std::vector<int>> patterns,
+                     unsigned int nThreads = 0);
+  // il formato binario e' quello predefinito, il testo resta per l'export
+  void save(const std::string& filepath,
+            FileFormat format = FileFormat::Binary) const;
   void loadMemory(const std::string& filepath);
 
   // elaborator
-  Matrix<double>& getMatrix() { return weightMatrix_; }
+  // chi modifica i pesi da qui invalida la cache dei campi locali
+  SymmetricMatrix<double>& getMatrix() {
+    version_ = nextVersion();
+    return weightMatrix_;
+  }
 
   // getter
-  const Matrix<double>& getMatrix() const;
+  const SymmetricMatrix<double>& getMatrix() const;
   // PatternUpdater
-  bool restorePattern(std::vector<int>& pattern);
-  bool restorePattern_withAnnealing(std::vector<int>& pattern, int n);
+  // nThreads vale solo per Synchronous (0 = tutti i core)
+  bool restorePattern(std::vector<int>& pattern,
+                      UpdateMode mode = UpdateMode::Asynchronous,
+                      unsigned int nThreads = 0) {
+    return restorePattern(pattern, workspace_, mode, nThreads);
+  }
+  // lo stesso sweep con lo stato in work: piu' thread possono recuperare
+  // dalla stessa rete, ognuno con il suo workspace
+  bool restorePattern(std::vector<int>& pattern, RecallWorkspace& work,
+                      UpdateMode mode = UpdateMode::Asynchronous,
+                      unsigned int nThreads = 0) const;
+  // le uniformi dei test di accettazione arrivano da uniform: di default lo
+  // stream del thread, cosi' reti usate da thread diversi non condividono un
+  // generatore. Stesso seme, stessa sequenza di mosse accettate
+  bool restorePattern_withAnnealing(
+      std::vector<int>& pattern, int n,
+      UniformStream& uniform = threadUniformStream()) {
+    return restorePattern_withAnnealing(pattern, n, workspace_, uniform);
+  }
+  // con lo stato (e la temperatura adattiva) in work
+  bool restorePattern_withAnnealing(
+      std::vector<int>& pattern, int n, RecallWorkspace& work,
+      UniformStream& uniform = threadUniformStream()) const;
+  // lastFlipCount e oscillating valgono per i metodi senza workspace
+  // esplicito (con un workspace: work.flipped.size(), work.oscillating)
+  std::size_t lastFlipCount() const { return workspace_.flipped.size(); }
+  // un '#' su std::cout a ogni sweep (le demo); da spegnere quando si
+  // recupera da piu' thread o senza terminale
+  void setProgress(bool enabled) { progress_ = enabled; }
+  // true se l'ultimo passo sincrono e' tornato allo stato di due passi prima
+  bool oscillating() const { return workspace_.oscillating; }
+  // recupera piu' pattern insieme, ripetendo gli sweep finche' ciascuno e'
+  // stabile (al massimo maxSweeps). I campi di tutti i pattern si calcolano
+  // con un prodotto matrice-matrice, e chi converge esce dal blocco. Ritorna
+  // per ogni pattern se e' arrivato a un punto fisso (un ciclo di periodo 2
+  // in modalita' Synchronous non conta). Non tocca la cache dei campi.
+  // nThreads divide i prodotti fra gruppi di pattern (0 = tutti i core).
+  // Se sweeps non e' vuoto, sweeps[q] riceve gli sweep fatti dal pattern q
+  std::vector<bool> restoreBatch(std::span<std::vector<int>> patterns,
+                                 UpdateMode mode = UpdateMode::Asynchronous,
+                                 std::size_t maxSweeps = 100,
+                                 unsigned int nThreads = 0,
+                                 std::span<std::size_t> sweeps = {}) const;
 
   // annealing functions
   double totalEnergy(const std::vector<int>& pattern) const;
-  bool probability(double dE, double temp) const;
+  bool probability(double dE, double temp,
+                   UniformStream& uniform = threadUniformStream()) const;
   double CoolingSchedule(int iter) const;
+  // logaritmica di default; la temperatura iniziale resta 50
+  void setCoolingSchedule(CoolingPolicy policy) { cooling_.setPolicy(policy); }
 };
 }  // namespace abc
 
@@ -2,13 +2,22 @@
 
 #include "ClassicHopfieldNetwork.hpp"
 
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "../Matrix/TempFile.hpp"
 #include "../doctest.h"
 
 TEST_CASE("Costructor") {
   std::size_t dim = 10;
   abc::ClassicHopfieldNetwork net(dim);
 
-  CHECK(net.getMatrix().getMatrix()[0].size() == dim);
+  CHECK(net.getMatrix().cols() == dim);
+  CHECK(net.getMatrix().packedSize() == dim * (dim - 1) / 2);
   CHECK(net.getMatrix().size() == dim);
 
   for (std::size_t i = 0; i < dim; ++i) {
@@ -34,7 +43,7 @@ TEST_CASE("Testing learning pattern") {
 
     CHECK(mat.size() == testPattern.size());
 
-    for (unsigned int i = 0; i < mat.getMatrix().size(); ++i) {
+    for (unsigned int i = 0; i < mat.size(); ++i) {
       CHECK(mat.size() == testPattern.size());
       for (unsigned int j = 0; j < mat.size(); ++j) {
         if (i == j) {
@@ -67,6 +76,66 @@ TEST_CASE("Testing learning pattern") {
     CHECK(mat.getElement(3, 1) == -0.5);
     CHECK(mat.getElement(2, 3) == -0.5);
   }
+  SUBCASE("Testing learning pattern - batch matches sequential learning") {
+    std::vector<std::vector<int>> batch;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> coin(0, 1);
+    for (int p = 0; p < 7; ++p) {
+      std::vector<int> pattern(300);
+      for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+      batch.push_back(pattern);
+    }
+    abc::ClassicHopfieldNetwork sequential(300);
+    for (const auto& pattern : batch) sequential.learnPattern(pattern);
+    abc::ClassicHopfieldNetwork batched(300);
+    batched.learnPatterns(batch, 4);
+
+    int mismatches{0};
+    for (std::size_t i = 0; i < 300; ++i) {
+      for (std::size_t j = 0; j < 300; ++j) {
+        if (batched.getMatrix().getElement(i, j) !=
+            doctest::Approx(sequential.getMatrix().getElement(i, j))) {
+          ++mismatches;
+        }
+      }
+    }
+    CHECK(mismatches == 0);
+    CHECK(batched.getMatrix().getElement(5, 5) == 0.0);
+  }
+  SUBCASE("Testing learning pattern - batch rejects non-binary values") {
+    std::vector<std::vector<int>> batch{{1, -1, 0, 1}};
+    CHECK_THROWS_WITH_AS(net.learnPatterns(batch),
+                         "Patterns must contain only +1 and -1!",
+                         std::runtime_error);
+  }
+  SUBCASE("Testing learning pattern - single and batch accept the same") {
+    net.learnPattern({1, -1, 1, 1});
+    const abc::SymmetricMatrix<double> before{net.getMatrix()};
+    CHECK_THROWS_WITH_AS(net.learnPattern({1, -1, 2, 1}),
+                         "Patterns must contain only +1 and -1!",
+                         std::runtime_error);
+    // un pattern sbagliato nel blocco: nessuno dei precedenti e' imparato
+    std::vector<std::vector<int>> batch{{1, 1, 1, 1}, {1, -1, 0, 1}};
+    CHECK_THROWS_WITH_AS(net.learnPatterns(batch),
+                         "Patterns must contain only +1 and -1!",
+                         std::runtime_error);
+    CHECK(net.getMatrix().getElement(0, 1) == before.getElement(0, 1));
+
+    // dai pesi mappati entrambi copiano la matrice prima di scriverla
+    const abc::TempFile file("classic_learn.bin");
+    net.save(file.path());
+    abc::ClassicHopfieldNetwork single;
+    single.loadMemory(file.path());
+    abc::ClassicHopfieldNetwork batched;
+    batched.loadMemory(file.path());
+    REQUIRE(single.getMatrix().isMapped());
+    single.learnPattern({1, 1, -1, -1});
+    batched.learnPatterns(std::vector<std::vector<int>>{{1, 1, -1, -1}});
+    CHECK_FALSE(single.getMatrix().isMapped());
+    CHECK_FALSE(batched.getMatrix().isMapped());
+    CHECK(single.getMatrix().getElement(0, 1) ==
+          doctest::Approx(batched.getMatrix().getElement(0, 1)));
+  }
   SUBCASE("Testing learning pattern - Learning non-suitable pattern") {
     std::vector<int> testPattern1 = {-1, 1, 1, -1};
     std::vector<int> testPattern2 = {1, -1, -1};
@@ -79,6 +148,29 @@ TEST_CASE("Testing learning pattern") {
   }
 }
 
+TEST_CASE("Testing save and loadMemory") {
+  abc::ClassicHopfieldNetwork net(4);
+  net.learnPattern({1, -1, 1, 1});
+
+  SUBCASE("Binary memory file is mapped back") {
+    const abc::TempFile file("classic_memory.bin");
+    net.save(file.path());
+    abc::ClassicHopfieldNetwork loaded;
+    loaded.loadMemory(file.path());
+    CHECK(loaded.getMatrix().isMapped());
+    CHECK(loaded.getMatrix().getElement(0, 1) == doctest::Approx(-0.25));
+    CHECK(loaded.getMatrix().getElement(2, 3) == doctest::Approx(0.25));
+  }
+  SUBCASE("Text export is still readable") {
+    const abc::TempFile file("classic_memory.txt");
+    net.save(file.path(), abc::FileFormat::Text);
+    abc::ClassicHopfieldNetwork loaded;
+    loaded.loadMemory(file.path());
+    CHECK_FALSE(loaded.getMatrix().isMapped());
+    CHECK(loaded.getMatrix().getElement(0, 1) == doctest::Approx(-0.25));
+  }
+}
+
 // MAIN TEST
 TEST_CASE("Testing restore pattern") {
   abc::ClassicHopfieldNetwork net(4);
@@ -104,6 +196,232 @@ TEST_CASE("Testing restore pattern") {
                          std::runtime_error);
   }
 }
+TEST_CASE("Testing restore pattern - cached local fields") {
+  const std::size_t dim{120};
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> coin(0, 1);
+  auto randomPattern = [&]() {
+    std::vector<int> pattern(dim);
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    return pattern;
+  };
+
+  abc::ClassicHopfieldNetwork net(dim);
+  std::vector<int> stored;
+  // numero dispari di pattern: i campi non sono mai esattamente nulli, quindi
+  // l'ordine delle somme non puo' cambiare il segno
+  for (int p = 0; p < 7; ++p) {
+    stored = randomPattern();
+    net.learnPattern(stored);
+  }
+
+  // riferimento: aggiornamento asincrono calcolando ogni campo da zero
+  auto referenceSweep = [&](std::vector<int>& pattern) {
+    for (std::size_t i = 0; i < dim; ++i) {
+      double field{0.0};
+      for (std::size_t j = 0; j < dim; ++j) {
+        field += net.getMatrix().getElement(i, j) * pattern[j];
+      }
+      pattern[i] = field > 0.0 ? 1 : -1;
+    }
+  };
+
+  std::vector<int> query = randomPattern();
+  std::vector<int> reference = query;
+  bool converged{false};
+  for (int sweep = 0; sweep < 20 && !converged; ++sweep) {
+    converged = net.restorePattern(query);
+    referenceSweep(reference);
+    CHECK(query == reference);
+  }
+  CHECK(converged);
+  CHECK(net.lastFlipCount() == 0);
+
+  SUBCASE("a new query does not reuse the previous fields") {
+    std::vector<int> other = stored;
+    other[0] = -other[0];
+    other[1] = -other[1];
+    std::vector<int> otherReference = other;
+    net.restorePattern(other);
+    referenceSweep(otherReference);
+    CHECK(other == otherReference);
+  }
+  SUBCASE("a workspace does not keep fields across a learnPattern") {
+    abc::ClassicHopfieldNetwork::RecallWorkspace work;
+    std::vector<int> state = randomPattern();
+    net.restorePattern(state, work);
+    // stesso stato lasciato dallo sweep, ma pesi nuovi
+    net.learnPattern(randomPattern());
+    std::vector<int> stateReference = state;
+    net.restorePattern(state, work);
+    referenceSweep(stateReference);
+    CHECK(state == stateReference);
+  }
+  SUBCASE("one const network, one workspace per thread") {
+    net.setProgress(false);
+    net.setCoolingSchedule(abc::AdaptiveCooling{});
+    std::vector<std::vector<int>> queries(8);
+    for (auto& q : queries) q = randomPattern();
+    // query pari senza annealing, dispari con l'annealing adattivo
+    auto recall = [](auto& network, std::vector<int>& state, std::size_t q,
+                     auto&... work) {
+      abc::UniformStream uniform(q);
+      for (int n = 0; n < 20; ++n) {
+        if (q % 2 == 0 ? network.restorePattern(state, work...)
+                       : network.restorePattern_withAnnealing(
+                             state, n, work..., uniform)) {
+          break;
+        }
+      }
+    };
+    // riferimento in sequenza, con il workspace della rete
+    std::vector<std::vector<int>> expected = queries;
+    for (std::size_t q = 0; q < expected.size(); ++q) {
+      recall(net, expected[q], q);
+    }
+
+    const abc::ClassicHopfieldNetwork& shared{net};
+    std::vector<std::vector<int>> parallel = queries;
+    auto half = [&](std::size_t first) {
+      abc::ClassicHopfieldNetwork::RecallWorkspace work;
+      for (std::size_t q = first; q < parallel.size(); q += 2) {
+        recall(shared, parallel[q], q, work);
+      }
+    };
+    std::thread even(half, 0);
+    std::thread odd(half, 1);
+    even.join();
+    odd.join();
+    CHECK(parallel == expected);
+  }
+}
+TEST_CASE("Testing restore pattern - synchronous update") {
+  const std::size_t dim{120};
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> coin(0, 1);
+  abc::ClassicHopfieldNetwork net(dim);
+  std::vector<std::vector<int>> stored(7, std::vector<int>(dim));
+  for (auto& pattern : stored) {
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    net.learnPattern(pattern);
+  }
+  const auto& weights = std::as_const(net).getMatrix();
+
+  SUBCASE("one step applies sign(W s) to all neurons together") {
+    std::vector<int> query = stored[2];
+    for (std::size_t i = 0; i < dim; i += 4) query[i] = -query[i];
+    std::vector<int> expected(dim);
+    for (std::size_t i = 0; i < dim; ++i) {
+      expected[i] = weights.field(i, query) > 0.0 ? 1 : -1;
+    }
+    net.restorePattern(query, abc::UpdateMode::Synchronous, 4);
+    CHECK(query == expected);
+  }
+  SUBCASE("the thread count does not change the result") {
+    std::vector<int> serial = stored[5];
+    for (std::size_t i = 0; i < dim; i += 3) serial[i] = -serial[i];
+    std::vector<int> parallel = serial;
+    abc::ClassicHopfieldNetwork other(net);
+    bool done{false};
+    for (int step = 0; step < 20 && !done; ++step) {
+      done = net.restorePattern(serial, abc::UpdateMode::Synchronous, 1);
+      other.restorePattern(parallel, abc::UpdateMode::Synchronous, 3);
+      CHECK(serial == parallel);
+    }
+    CHECK(done);
+  }
+  SUBCASE("a stored pattern is a fixed point") {
+    std::vector<int> query = stored[0];
+    CHECK(net.restorePattern(query, abc::UpdateMode::Synchronous));
+    CHECK(query == stored[0]);
+    CHECK_FALSE(net.oscillating());
+  }
+}
+TEST_CASE("Testing restore pattern - synchronous 2-cycle") {
+  // con un solo peso negativo lo stato sincrono salta fra (1, 1) e (-1, -1)
+  abc::ClassicHopfieldNetwork net(2);
+  net.getMatrix().setElement(0, 1, -1.0);
+  std::vector<int> state{1, 1};
+  CHECK_FALSE(net.restorePattern(state, abc::UpdateMode::Synchronous));
+  CHECK(state == std::vector<int>{-1, -1});
+  CHECK_FALSE(net.oscillating());
+  CHECK(net.restorePattern(state, abc::UpdateMode::Synchronous));
+  CHECK(state == std::vector<int>{1, 1});
+  CHECK(net.oscillating());
+  // l'aggiornamento asincrono invece si ferma
+  state = {1, 1};
+  net.restorePattern(state);
+  CHECK(state == std::vector<int>{-1, 1});
+  CHECK(net.restorePattern(state));
+}
+TEST_CASE("Testing restoreBatch") {
+  const std::size_t dim{150};
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> coin(0, 1);
+  auto randomPattern = [&]() {
+    std::vector<int> pattern(dim);
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    return pattern;
+  };
+  abc::ClassicHopfieldNetwork net(dim);
+  std::vector<std::vector<int>> stored;
+  // numero dispari di pattern: nessun campo nullo (vedi sopra)
+  for (int p = 0; p < 9; ++p) {
+    stored.push_back(randomPattern());
+    net.learnPattern(stored.back());
+  }
+  std::vector<std::vector<int>> queries{stored[0], stored[3]};
+  for (std::size_t i = 0; i < dim; i += 5) queries[1][i] = -queries[1][i];
+  for (int q = 0; q < 5; ++q) queries.push_back(randomPattern());
+
+  SUBCASE("asynchronous batch matches restorePattern") {
+    std::vector<std::vector<int>> expected = queries;
+    std::vector<std::size_t> expectedSweeps;
+    abc::ClassicHopfieldNetwork single(net);
+    for (auto& query : expected) {
+      // il blocco si ferma al primo sweep senza cambiamenti
+      std::size_t count{0};
+      do {
+        single.restorePattern(query);
+        ++count;
+      } while (count < 50 && single.lastFlipCount() > 0);
+      expectedSweeps.push_back(count);
+    }
+    std::vector<std::size_t> sweeps(queries.size());
+    const auto converged = net.restoreBatch(
+        queries, abc::UpdateMode::Asynchronous, 100, 2, sweeps);
+    CHECK(queries == expected);
+    CHECK(sweeps == expectedSweeps);
+    CHECK(std::all_of(converged.begin(), converged.end(),
+                      [](bool c) { return c; }));
+    CHECK(queries[0] == stored[0]);
+  }
+  SUBCASE("synchronous batch matches the synchronous mode") {
+    std::vector<std::vector<int>> expected = queries;
+    std::vector<bool> expectedConverged;
+    for (auto& query : expected) {
+      abc::ClassicHopfieldNetwork single(net);
+      bool done{false};
+      for (int step = 0; step < 50 && !done; ++step) {
+        done = single.restorePattern(query, abc::UpdateMode::Synchronous);
+      }
+      expectedConverged.push_back(!single.oscillating());
+    }
+    CHECK(net.restoreBatch(queries, abc::UpdateMode::Synchronous) ==
+          expectedConverged);
+    CHECK(queries == expected);
+  }
+  SUBCASE("sweep limit and wrong dimension") {
+    std::vector<std::vector<int>> limited{queries[1]};
+    CHECK(net.restoreBatch(limited, abc::UpdateMode::Asynchronous, 0) ==
+          std::vector<bool>{false});
+    CHECK(limited[0] == queries[1]);
+    std::vector<std::vector<int>> wrong{std::vector<int>(dim - 1, 1)};
+    CHECK_THROWS_WITH_AS(net.restoreBatch(wrong),
+                         "matrix and pattern sizes do not match!",
+                         std::runtime_error);
+  }
+}
 TEST_CASE("Testing Energy Functions") {
   abc::ClassicHopfieldNetwork net(3);
   auto& weights = net.getMatrix();
@@ -132,6 +450,14 @@ TEST_CASE("Testing Annealing") {
     CHECK(net.CoolingSchedule(1) > net.CoolingSchedule(10));
     CHECK(net.CoolingSchedule(100000) < 5);
   }
+  SUBCASE("the cooling policy can be changed") {
+    abc::ClassicHopfieldNetwork net(4);
+    net.setCoolingSchedule(abc::GeometricCooling{0.5});
+    CHECK(net.CoolingSchedule(0) == doctest::Approx(50));
+    CHECK(net.CoolingSchedule(2) == doctest::Approx(12.5));
+    net.setCoolingSchedule(abc::LinearCooling{10.0});
+    CHECK(net.CoolingSchedule(6) == 0.0);
+  }
   SUBCASE("probability returns true more often for high temperature") {
     abc::ClassicHopfieldNetwork net;
 
@@ -149,6 +475,68 @@ TEST_CASE("Testing Annealing") {
 
     CHECK(accept_count_high > accept_count_low);
   }
+  SUBCASE("the same seed gives the same annealing run") {
+    abc::ClassicHopfieldNetwork net(40);
+    std::vector<int> stored(40);
+    for (std::size_t i = 0; i < stored.size(); ++i) {
+      stored[i] = (i * 3 % 7 < 3) ? 1 : -1;
+    }
+    net.learnPattern(stored);
+    abc::ClassicHopfieldNetwork other(net);
+    abc::UniformStream netUniform(99);
+    abc::UniformStream otherUniform(99);
+    std::vector<int> a(40, 1);
+    std::vector<int> b(40, 1);
+    for (int iter = 0; iter < 10; ++iter) {
+      net.restorePattern_withAnnealing(a, iter, netUniform);
+      other.restorePattern_withAnnealing(b, iter, otherUniform);
+      CHECK(a == b);
+    }
+    std::vector<bool> first;
+    std::vector<bool> second;
+    abc::UniformStream uniform(7);
+    for (int i = 0; i < 50; ++i) {
+      first.push_back(net.probability(1.0, 1.0, uniform));
+    }
+    uniform.seed(7);
+    for (int i = 0; i < 50; ++i) {
+      second.push_back(net.probability(1.0, 1.0, uniform));
+    }
+    CHECK(first == second);
+  }
+  SUBCASE("restorePattern_withAnnealing keeps a stored pattern fixed") {
+    abc::ClassicHopfieldNetwork net(6);
+    std::vector<int> pattern = {1, -1, 1, -1, 1, 1};
+    net.learnPattern(pattern);
+
+    std::vector<int> state = pattern;
+    for (int iter = 0; iter < 5; ++iter) {
+      net.restorePattern_withAnnealing(state, iter);
+      CHECK(state == pattern);
+      CHECK(net.lastFlipCount() == 0);
+    }
+  }
+  SUBCASE("restorePattern_withAnnealing keeps the cached fields consistent") {
+    abc::ClassicHopfieldNetwork net(5);
+    std::vector<int> pattern = {1, -1, 1, -1, 1};
+    net.learnPattern(pattern);
+
+    std::vector<int> corrupted = {-1, 1, -1, -1, 1};
+    for (int iter = 0; iter < 3; ++iter) {
+      net.restorePattern_withAnnealing(corrupted, iter);
+    }
+    // lo sweep deterministico riparte dai campi mantenuti dall'annealing
+    std::vector<int> reference = corrupted;
+    net.restorePattern(corrupted);
+    for (std::size_t i = 0; i < reference.size(); ++i) {
+      double field{0.0};
+      for (std::size_t j = 0; j < reference.size(); ++j) {
+        field += net.getMatrix().getElement(i, j) * reference[j];
+      }
+      reference[i] = field > 0.0 ? 1 : -1;
+    }
+    CHECK(corrupted == reference);
+  }
   SUBCASE("restorePattern_withAnnealing converges to a stable pattern") {
     abc::ClassicHopfieldNetwork net(5);
     std::vector<int> pattern = {1, -1, 1, -1, 1};
@@ -165,4 +553,17 @@ TEST_CASE("Testing Annealing") {
 
     CHECK(corrupted == pattern);  // convergenza al pattern originale
   }
-}
\ No newline at end of file
+  SUBCASE("the progress marks can be turned off") {
+    abc::ClassicHopfieldNetwork net(4);
+    net.learnPattern({1, -1, 1, -1});
+    std::vector<int> state{1, 1, 1, -1};
+    std::ostringstream out;
+    auto* previous = std::cout.rdbuf(out.rdbuf());
+    net.restorePattern(state);
+    net.setProgress(false);
+    net.restorePattern(state);
+    net.restorePattern_withAnnealing(state, 0);
+    std::cout.rdbuf(previous);
+    CHECK(out.str() == "#");
+  }
+}
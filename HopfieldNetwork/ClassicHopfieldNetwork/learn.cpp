@@ -43,15 +43,19 @@ int main() {
 
     std::cout << "STARTING LEARNING PROCESS\n" << std::flush;
 
+    // pattern gia' ridotti delle esecuzioni precedenti
+    const abc::PatternCache cache("PatternCache");
+    std::vector<std::vector<int>> patterns;
+    patterns.reserve(images.size());
     for (const auto& path : images) {
       std::cout << "Processing image:\t" << path << '\n';
-      abc::HopfieldImagePattern pattern(path, dimension);
-      pattern.adaptImage_withBilinearInterpolation();
+      abc::HopfieldImagePattern pattern(path, dimension, cache);
 
-      net.learnPattern(pattern.getPattern());
+      patterns.push_back(pattern.getPattern());
     }
+    net.learnPatterns(patterns);  // un solo aggiornamento per tutto il set
 
-    net.save("ClassicMatrixValues.txt");
+    net.save("ClassicMatrixValues.bin");
     std::cout << "LEARNING COMPLETED\n" << std::flush;
 
   } catch (std::exception const& e) {
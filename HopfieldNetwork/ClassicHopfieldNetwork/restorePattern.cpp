@@ -17,7 +17,7 @@ int main() {
     std::cin >> filePath;
 
     if (filePath == "#") {
-      filePath = "ClassicMatrixValues.txt";
+      filePath = "ClassicMatrixValues.bin";
     }
     abc::ClassicHopfieldNetwork net;
     std::cout << "loading memory...\n";
@@ -167,8 +167,8 @@ int main() {
       if (start) {
         if (!net.restorePattern_withAnnealing(pattern.elaboratePattern(), n)) {
           std::cout << '#' << std::flush;
-          updateTexture.update(pattern.printPattern());
-          updateSprite.setTexture(updateTexture);
+          // pixel scritti nella texture esistente, senza sf::Image per frame
+          pattern.updateTexture(updateTexture);
 
           // assert(net.totalEnergy(pattern.getPattern()) <= Energy);
           Entext.setString("Energy: " + std::to_string(net.totalEnergy(
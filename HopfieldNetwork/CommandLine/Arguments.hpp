@@ -0,0 +1,116 @@
+#ifndef HOPFIELDNEURALNETWORK_ARGUMENTS_H
+#define HOPFIELDNEURALNETWORK_ARGUMENTS_H
+
+#include <algorithm>
+#include <cctype>
+#include <initializer_list>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace abc {
+
+// opzioni della riga di comando nella forma --nome valore. Un'opzione non
+// prevista o senza valore e' un errore, come un valore non numerico dove
+// serve un numero
+class Arguments {
+ private:
+  std::map<std::string, std::string, std::less<>> values_;
+
+  static std::runtime_error invalid(std::string_view name) {
+    return std::runtime_error("Invalid value for --" + std::string(name));
+  }
+
+ public:
+  Arguments(int argc, char* argv[],
+            std::initializer_list<std::string_view> known) {
+    for (int i = 1; i < argc; ++i) {
+      const std::string_view arg{argv[i]};
+      if (!arg.starts_with("--")) {
+        throw std::runtime_error("Unexpected argument: " + std::string(arg));
+      }
+      const std::string_view name{arg.substr(2)};
+      if (std::find(known.begin(), known.end(), name) == known.end()) {
+        throw std::runtime_error("Unknown option: " + std::string(arg));
+      }
+      if (i + 1 == argc) {
+        throw std::runtime_error("Missing value for " + std::string(arg));
+      }
+      values_[std::string(name)] = argv[++i];
+    }
+  }
+
+  // --help in qualunque posizione
+  static bool wantsHelp(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+      if (std::string_view{argv[i]} == "--help") {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool has(std::string_view name) const { return values_.contains(name); }
+  std::string get(std::string_view name, const std::string& fallback) const {
+    const auto it = values_.find(name);
+    return it == values_.end() ? fallback : it->second;
+  }
+  std::string required(std::string_view name) const {
+    const auto it = values_.find(name);
+    if (it == values_.end()) {
+      throw std::runtime_error("Missing required option --" +
+                               std::string(name));
+    }
+    return it->second;
+  }
+  double number(std::string_view name, double fallback) const {
+    const auto it = values_.find(name);
+    if (it == values_.end()) {
+      return fallback;
+    }
+    std::size_t used{0};
+    double value{0.0};
+    try {
+      value = std::stod(it->second, &used);
+    } catch (const std::exception&) {
+      throw invalid(name);
+    }
+    if (used != it->second.size()) {
+      throw invalid(name);
+    }
+    return value;
+  }
+  // interi senza segno: "-1" non diventa un numero enorme
+  unsigned long count(std::string_view name, unsigned long fallback) const {
+    const auto it = values_.find(name);
+    if (it == values_.end()) {
+      return fallback;
+    }
+    const std::string& text{it->second};
+    if (text.empty() ||
+        !std::all_of(text.begin(), text.end(),
+                     [](unsigned char c) { return std::isdigit(c) != 0; })) {
+      throw invalid(name);
+    }
+    try {
+      return std::stoul(text);
+    } catch (const std::exception&) {
+      throw invalid(name);
+    }
+  }
+  // valore fra quelli ammessi
+  std::string choice(std::string_view name, const std::string& fallback,
+                     const std::vector<std::string>& allowed) const {
+    std::string value{get(name, fallback)};
+    if (std::find(allowed.begin(), allowed.end(), value) == allowed.end()) {
+      throw invalid(name);
+    }
+    return value;
+  }
+};
+
+}  // namespace abc
+
+#endif
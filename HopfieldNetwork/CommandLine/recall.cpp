@@ -0,0 +1,381 @@
+// recupero senza interfaccia grafica: tutte le immagini di una cartella, alla
+// velocita' della macchina (le demo fanno uno sweep per frame, un frame al
+// secondo), con i pattern recuperati e le misure di ogni query su file
+// uso: HopfieldRecall --memory FILE --images DIR [opzioni], vedi --help
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+
+#include "../ClassicHopfieldNetwork/ClassicHopfieldNetwork.hpp"
+#include "../HopfieldImagePattern/HopfieldImagePattern.hpp"
+#include "../ModernHopfieldNetwork/ModernHopfieldNetwork.hpp"
+#include "Arguments.hpp"
+
+namespace {
+
+constexpr const char* kUsage =
+    "Usage: HopfieldRecall --memory FILE --images DIR [options]\n"
+    "  --network classic|modern     network that saved FILE (classic)\n"
+    "  --mode MODE                  classic: async, sync, anneal\n"
+    "                               modern: async, anneal, attention (async)\n"
+    "  --corruption FRACTION        fraction of flipped pixels or blocks\n"
+    "                               (0.25)\n"
+    "  --noise pixels|blocks        flip single pixels or whole tiles\n"
+    "  --block-side S               side of the flipped tiles (8)\n"
+    "  --max-sweeps N               sweeps per query at most (100)\n"
+    "  --threads N                  recall threads, 0 = all (0)\n"
+    "  --seed N                     corruption and annealing seed\n"
+    "  --temp0 E                    modern: initial temperature 4.5 * E\n"
+    "  --beta B                     modern attention: inverse temperature\n"
+    "  --top-k K                    modern: recall over K indexed memories\n"
+    "  --out DIR                    output directory (recall_out)\n"
+    "  --format csv|json            per-query results format (csv)\n"
+    "  --save-images 0|1            write the restored patterns (1)\n"
+    "  --cache DIR                  reuse the patterns preprocessed in DIR\n";
+
+struct QueryResult {
+  std::string image;
+  std::size_t sweeps{0};
+  bool converged{false};
+  double milliseconds{0.0};
+  double corruptedOverlap{0.0};  // <s, originale> / N prima del recupero
+  double restoredOverlap{0.0};   // e dopo
+};
+
+using Clock = std::chrono::steady_clock;
+
+// una query: il pattern corrotto (recuperato sul posto), l'originale per gli
+// overlap e il primo errore dei thread che l'hanno elaborata
+struct Query {
+  std::optional<abc::HopfieldImagePattern> pattern;
+  std::vector<int> original;
+  QueryResult result;
+  std::exception_ptr error;
+};
+
+// body(q) per ogni query, in parallelo: le eccezioni restano nella query
+template <class Body>
+void forEachQuery(std::vector<Query>& queries, unsigned int threads,
+                  Body body) {
+  abc::parallelFor(
+      queries.size(),
+      [&](std::size_t q) {
+        try {
+          body(q, queries[q]);
+        } catch (...) {
+          queries[q].error = std::current_exception();
+        }
+      },
+      threads);
+}
+void rethrowFirst(const std::vector<Query>& queries) {
+  for (const auto& query : queries) {
+    if (query.error) {
+      std::rethrow_exception(query.error);
+    }
+  }
+}
+
+// una query per thread alla volta, tutti sulla stessa rete const: ogni
+// thread scrive solo nel suo workspace di recupero.
+// sweep(rete, stato, iterazione, workspace, uniformi) ritorna true se lo
+// stato e' stabile; le uniformi dell'annealing hanno uno stream per query
+template <class Network, class Sweep>
+void recallEach(const Network& network, std::vector<Query>& queries,
+                int maxSweeps, unsigned int threads, std::uint64_t seed,
+                Sweep sweep) {
+  abc::ThreadPool pool(static_cast<unsigned int>(std::clamp<std::size_t>(
+      queries.size(), 1, abc::resolveThreadCount(threads))));
+  std::vector<typename Network::RecallWorkspace> workspaces(pool.size());
+  pool.run(queries.size(), [&](std::size_t q, unsigned int worker) {
+    auto& work{workspaces[worker]};
+    Query& query{queries[q]};
+    try {
+      // indici dopo quelli del rumore: le uniformi non ripetono la sequenza
+      // che ha scelto i pixel da corrompere
+      abc::UniformStream uniform(abc::streamSeed(seed, queries.size() + q));
+      std::vector<int>& state{query.pattern->elaboratePattern()};
+      const auto start = Clock::now();
+      for (int n = 0; n < maxSweeps && !query.result.converged; ++n) {
+        query.result.converged = sweep(network, state, n, work, uniform);
+        ++query.result.sweeps;
+      }
+      query.result.milliseconds =
+          std::chrono::duration<double, std::milli>(Clock::now() - start)
+              .count();
+    } catch (...) {
+      query.error = std::current_exception();
+    }
+  });
+}
+
+// rete classica senza annealing: blocchi di query con restoreBatch, ogni
+// peso letto una volta per tutto il blocco e i prodotti divisi fra i thread.
+// La latenza di una query e' il tempo del blocco diviso fra le sue query
+void recallBatches(const abc::ClassicHopfieldNetwork& network,
+                   std::vector<Query>& queries, abc::UpdateMode mode,
+                   int maxSweeps, unsigned int threads) {
+  constexpr std::size_t kBlock{64};
+  for (std::size_t first = 0; first < queries.size(); first += kBlock) {
+    const std::size_t count{std::min(kBlock, queries.size() - first)};
+    std::vector<std::vector<int>> states(count);
+    for (std::size_t k = 0; k < count; ++k) {
+      states[k].swap(queries[first + k].pattern->elaboratePattern());
+    }
+    std::vector<std::size_t> sweeps(count);
+    const auto start = Clock::now();
+    const auto converged{network.restoreBatch(
+        states, mode, static_cast<std::size_t>(maxSweeps), threads, sweeps)};
+    const std::chrono::duration<double, std::milli> elapsed{Clock::now() -
+                                                            start};
+    for (std::size_t k = 0; k < count; ++k) {
+      QueryResult& result{queries[first + k].result};
+      states[k].swap(queries[first + k].pattern->elaboratePattern());
+      result.sweeps = sweeps[k];
+      result.converged = converged[k];
+      result.milliseconds = elapsed.count() / static_cast<double>(count);
+    }
+  }
+}
+
+double overlap(const std::vector<int>& a, const std::vector<int>& b) {
+  long sum{0};
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    sum += a[i] * b[i];
+  }
+  return static_cast<double>(sum) / static_cast<double>(a.size());
+}
+
+std::string quoted(const std::string& text, char escape) {
+  std::string out{"\""};
+  for (const char c : text) {
+    if (c == '"' || (escape == '\\' && c == '\\')) {
+      out += escape;
+    }
+    out += c;
+  }
+  return out + '"';
+}
+
+void writeCsv(const std::string& path,
+              const std::vector<QueryResult>& results) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot create the file!");
+  }
+  file << "image,sweeps,converged,latency_ms,overlap_corrupted,"
+          "overlap_restored\n";
+  for (const auto& r : results) {
+    // nei csv le virgolette si raddoppiano
+    file << quoted(r.image, '"') << ',' << r.sweeps << ','
+         << (r.converged ? 1 : 0) << ',' << r.milliseconds << ','
+         << r.corruptedOverlap << ',' << r.restoredOverlap << '\n';
+  }
+}
+
+void writeJson(const std::string& path,
+               const std::vector<QueryResult>& results) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot create the file!");
+  }
+  file << "[\n";
+  for (std::size_t q = 0; q < results.size(); ++q) {
+    const auto& r = results[q];
+    file << "  {\"image\": " << quoted(r.image, '\\')
+         << ", \"sweeps\": " << r.sweeps
+         << ", \"converged\": " << (r.converged ? "true" : "false")
+         << ", \"latency_ms\": " << r.milliseconds
+         << ", \"overlap_corrupted\": " << r.corruptedOverlap
+         << ", \"overlap_restored\": " << r.restoredOverlap << '}'
+         << (q + 1 < results.size() ? ",\n" : "\n");
+  }
+  file << "]\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (abc::Arguments::wantsHelp(argc, argv)) {
+    std::cout << kUsage;
+    return 0;
+  }
+  try {
+    const abc::Arguments args(
+        argc, argv,
+        {"memory", "images", "network", "mode", "corruption", "noise",
+         "block-side", "max-sweeps",
+         "threads", "seed", "temp0", "beta", "top-k", "out", "format",
+         "save-images", "cache"});
+    const std::string network{
+        args.choice("network", "classic", {"classic", "modern"})};
+    const std::string mode{
+        network == "classic"
+            ? args.choice("mode", "async", {"async", "sync", "anneal"})
+            : args.choice("mode", "async", {"async", "anneal", "attention"})};
+    const double corruption{args.number("corruption", 0.25)};
+    if (corruption < 0.0 || corruption > 1.0) {
+      throw std::runtime_error("Invalid value for --corruption");
+    }
+    const bool blocks{args.choice("noise", "pixels", {"pixels", "blocks"}) ==
+                      "blocks"};
+    const auto blockSide =
+        static_cast<unsigned int>(args.count("block-side", 8));
+    if (blockSide == 0) {
+      throw std::runtime_error("Invalid value for --block-side");
+    }
+    const auto maxSweeps = static_cast<int>(args.count("max-sweeps", 100));
+    const auto threads = static_cast<unsigned int>(args.count("threads", 0));
+    const std::uint64_t seed{args.count("seed", abc::kDefaultSeed)};
+    const std::string outDir{args.get("out", "recall_out")};
+    const std::string format{args.choice("format", "csv", {"csv", "json"})};
+    const bool saveImages{args.count("save-images", 1) != 0};
+    const std::vector<std::string> images{
+        abc::setDirectory(args.required("images"))};
+    std::optional<abc::PatternCache> cache;
+    if (args.has("cache")) {
+      cache.emplace(args.required("cache"));
+    }
+
+    // la rete resta viva per tutto il main; niente '#' per sweep, le query
+    // vanno in parallelo
+    abc::ClassicHopfieldNetwork classic;
+    abc::ModernHopfieldNetwork modern;
+    std::size_t neurons{0};
+    std::cout << "loading memory...\n";
+    if (network == "classic") {
+      classic.loadMemory(args.required("memory"));
+      classic.setProgress(false);
+      neurons = classic.getMatrix().size();
+    } else {
+      modern.loadMemory(args.required("memory"));
+      modern.setProgress(false);
+      if (args.has("temp0")) {
+        modern.setTemp0(args.number("temp0", 0.0));
+      }
+      modern.setTopK(args.count("top-k", 0));
+      neurons = modern.neurons();
+    }
+    const double beta{args.number("beta", 1.0)};
+    const auto side = static_cast<unsigned int>(
+        std::lround(std::sqrt(static_cast<double>(neurons))));
+    if (static_cast<std::size_t>(side) * side != neurons) {
+      throw std::runtime_error("The memory does not hold square images");
+    }
+    std::filesystem::create_directories(outDir);
+
+    // lettura, riduzione e rumore in parallelo: un seme per query, il
+    // risultato non dipende dall'ordine ne' dal numero di thread
+    std::vector<Query> queries(images.size());
+    forEachQuery(queries, threads, [&](std::size_t q, Query& query) {
+      query.pattern.emplace(
+          cache ? abc::HopfieldImagePattern(images[q], side, *cache)
+                : abc::HopfieldImagePattern(images[q], side));
+      abc::HopfieldImagePattern& pattern{*query.pattern};
+      if (pattern.getPatternDimension() == 0) {
+        pattern.adaptImage_withBilinearInterpolation();
+      }
+      query.original = pattern.getPattern();
+      if (blocks) {
+        const unsigned int tiles{(side + blockSide - 1) / blockSide};
+        pattern.corruptBlocks(
+            blockSide,
+            static_cast<std::size_t>(
+                std::ceil(static_cast<double>(tiles * tiles) * corruption)),
+            abc::streamSeed(seed, q));
+      } else {
+        pattern.corrupt(static_cast<std::size_t>(std::ceil(
+                            static_cast<double>(neurons) * corruption)),
+                        abc::streamSeed(seed, q));
+      }
+      query.result.image = images[q];
+      query.result.corruptedOverlap =
+          overlap(pattern.getPattern(), query.original);
+    });
+    rethrowFirst(queries);
+
+    const auto start = Clock::now();
+    if (network == "classic" && mode != "anneal") {
+      recallBatches(classic, queries,
+                    mode == "sync" ? abc::UpdateMode::Synchronous
+                                   : abc::UpdateMode::Asynchronous,
+                    maxSweeps, threads);
+    } else if (network == "classic") {
+      recallEach(
+          classic, queries, maxSweeps, threads, seed,
+          [](const abc::ClassicHopfieldNetwork& net, std::vector<int>& p,
+             int n, abc::ClassicHopfieldNetwork::RecallWorkspace& work,
+             abc::UniformStream& uniform) {
+            return net.restorePattern_withAnnealing(p, n, work, uniform);
+          });
+    } else {
+      recallEach(
+          modern, queries, maxSweeps, threads, seed,
+          [&](const abc::ModernHopfieldNetwork& net, std::vector<int>& p,
+              int n, abc::ModernHopfieldNetwork::RecallWorkspace& work,
+              abc::UniformStream& uniform) {
+            if (mode == "async") {
+              return net.restorePattern(p, work);
+            }
+            if (mode == "anneal") {
+              return net.restorePattern_withAnnealing(p, n, work, uniform);
+            }
+            return net.restoreAttention(p, beta, 1);
+          });
+    }
+    const std::chrono::duration<double, std::milli> total{Clock::now() -
+                                                          start};
+    rethrowFirst(queries);
+
+    forEachQuery(queries, threads, [&](std::size_t q, Query& query) {
+      query.result.restoredOverlap =
+          overlap(query.pattern->getPattern(), query.original);
+      if (saveImages) {
+        const std::filesystem::path path{images[q]};
+        query.pattern->printPattern().saveToFile(
+            (std::filesystem::path(outDir) /
+             (path.stem().string() + "_restored.png"))
+                .string());
+      }
+    });
+    rethrowFirst(queries);
+    std::vector<QueryResult> results;
+    results.reserve(queries.size());
+    std::size_t totalSweeps{0};
+    for (const auto& query : queries) {
+      results.push_back(query.result);
+      totalSweeps += query.result.sweeps;
+    }
+
+    const std::string resultsPath{
+        (std::filesystem::path(outDir) / ("results." + format)).string()};
+    if (format == "csv") {
+      writeCsv(resultsPath, results);
+    } else {
+      writeJson(resultsPath, results);
+    }
+
+    const double seconds{total.count() / 1e3};
+    std::cout << results.size() << " queries, " << totalSweeps
+              << " sweeps in " << total.count() << " ms";
+    if (seconds > 0.0) {
+      std::cout << " (" << static_cast<double>(results.size()) / seconds
+                << " queries/s, " << static_cast<double>(totalSweeps) / seconds
+                << " sweeps/s)";
+    }
+    std::cout << "\nresults written to " << resultsPath << '\n';
+  } catch (std::exception const& e) {
+    std::cerr << "Caught exception: '" << e.what() << "'\n";
+    std::cerr << kUsage;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Caught unknown exception\n";
+    return EXIT_FAILURE;
+  }
+}
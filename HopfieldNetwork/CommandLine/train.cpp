@@ -0,0 +1,319 @@
+// apprendimento senza domande su std::cin, a pipeline: decodifica delle
+// immagini in parallelo, ridimensionamento e binarizzazione in parallelo e
+// un solo stadio che impara, collegati da code a capacita' limitata
+// uso: HopfieldTrain --images DIR [opzioni], vedi --help
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "../ClassicHopfieldNetwork/ClassicHopfieldNetwork.hpp"
+#include "../HopfieldImagePattern/HopfieldImagePattern.hpp"
+#include "../Matrix/Parallel.hpp"
+#include "../ModernHopfieldNetwork/ModernHopfieldNetwork.hpp"
+#include "Arguments.hpp"
+
+namespace {
+
+constexpr const char* kUsage =
+    "Usage: HopfieldTrain --images DIR [options]\n"
+    "  --network classic|modern     network to train (classic)\n"
+    "  --size S                     patterns of S x S pixels (64)\n"
+    "  --out FILE                   memory file (ClassicMatrixValues.bin or\n"
+    "                               ModernMatrixValues.bin)\n"
+    "  --format binary|text         memory file format (binary)\n"
+    "  --decode-threads N           decoding threads, 0 = all cores (0)\n"
+    "  --resize-threads N           resizing threads, 0 = all cores (0)\n"
+    "  --queue N                    capacity of each queue (16)\n"
+    "  --batch N                    classic: patterns per Hebbian update\n"
+    "                               (32)\n"
+    "  --cache DIR                  reuse the patterns preprocessed in DIR\n";
+
+using Clock = std::chrono::steady_clock;
+
+// tempo di lavoro di uno stadio (somma sui suoi thread, attese escluse) e
+// istante in cui il suo ultimo thread ha finito
+struct StageTiming {
+  std::atomic<long long> busyNanoseconds{0};
+  std::atomic<std::size_t> items{0};
+  std::atomic<long long> endNanoseconds{0};
+
+  void add(Clock::duration busy) {
+    busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           busy)
+                           .count();
+    ++items;
+  }
+  void finish(Clock::time_point start) {
+    const long long end{std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            Clock::now() - start)
+                            .count()};
+    long long seen{endNanoseconds.load()};
+    while (seen < end && !endNanoseconds.compare_exchange_weak(seen, end)) {
+    }
+  }
+};
+
+struct Decoded {
+  std::size_t index;
+  abc::HopfieldImagePattern image;
+};
+struct Binarized {
+  std::size_t index;
+  std::vector<int> pattern;
+};
+
+// il primo errore di un thread ferma la pipeline e viene rilanciato dal main
+class FirstError {
+ private:
+  std::mutex mutex_;
+  std::exception_ptr error_;
+
+ public:
+  void set(std::exception_ptr error) {
+    std::lock_guard lock(mutex_);
+    if (!error_) {
+      error_ = error;
+    }
+  }
+  void rethrow() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+};
+
+void printStage(const char* name, unsigned int threads,
+                const StageTiming& timing) {
+  std::cout << std::left << std::setw(10) << name << std::setw(10) << threads
+            << std::setw(10) << timing.items.load() << std::setw(14)
+            << static_cast<double>(timing.busyNanoseconds.load()) / 1e6
+            << static_cast<double>(timing.endNanoseconds.load()) / 1e6
+            << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (abc::Arguments::wantsHelp(argc, argv)) {
+    std::cout << kUsage;
+    return 0;
+  }
+  try {
+    const abc::Arguments args(
+        argc, argv,
+        {"images", "network", "size", "out", "format", "decode-threads",
+         "resize-threads", "queue", "batch", "cache"});
+    const std::string network{
+        args.choice("network", "classic", {"classic", "modern"})};
+    const auto side = static_cast<unsigned int>(args.count("size", 64));
+    if (side < 2) {
+      throw std::runtime_error("Invalid value for --size");
+    }
+    const std::string out{args.get(
+        "out", network == "classic" ? "ClassicMatrixValues.bin"
+                                    : "ModernMatrixValues.bin")};
+    const abc::FileFormat format{
+        args.choice("format", "binary", {"binary", "text"}) == "binary"
+            ? abc::FileFormat::Binary
+            : abc::FileFormat::Text};
+    const unsigned int decodeThreads{abc::resolveThreadCount(
+        static_cast<unsigned int>(args.count("decode-threads", 0)))};
+    const unsigned int resizeThreads{abc::resolveThreadCount(
+        static_cast<unsigned int>(args.count("resize-threads", 0)))};
+    const std::size_t capacity{args.count("queue", 16)};
+    const std::size_t batch{std::max(1ul, args.count("batch", 32))};
+    const std::vector<std::string> images{
+        abc::setDirectory(args.required("images"))};
+    const std::size_t dimension{static_cast<std::size_t>(side) * side};
+    std::optional<abc::PatternCache> cache;
+    if (args.has("cache")) {
+      cache.emplace(args.required("cache"));
+    }
+
+    // solo la rete scelta: la matrice dei pesi classica occupa N^2 / 2 double
+    std::optional<abc::ClassicHopfieldNetwork> classic;
+    std::optional<abc::ModernHopfieldNetwork> modern;
+    if (network == "classic") {
+      classic.emplace(dimension);
+    } else {
+      modern.emplace(static_cast<int>(dimension));
+    }
+
+    abc::BoundedQueue<Decoded> decoded(capacity);
+    abc::BoundedQueue<Binarized> binarized(capacity);
+    StageTiming decodeTiming;
+    StageTiming resizeTiming;
+    StageTiming learnTiming;
+    FirstError error;
+    // pattern imparati finora: i decodificatori prendono solo le immagini
+    // entro capacity dall'ultima imparata, cosi' i pattern in attesa dello
+    // stadio 3 sono al piu' capacity. Un errore la porta a images.size() e
+    // sblocca chi aspetta
+    const std::size_t window{std::max<std::size_t>(capacity, 1)};
+    std::atomic<std::size_t> learned{0};
+    auto stop = [&]() {
+      learned = images.size();
+      learned.notify_all();
+      decoded.close();
+      binarized.close();
+    };
+    const auto start = Clock::now();
+
+    // stadio 1: lettura e decodifica, immagini distribuite con un contatore
+    std::atomic<std::size_t> nextImage{0};
+    std::atomic<std::size_t> cacheHits{0};
+    std::atomic<unsigned int> decoding{decodeThreads};
+    std::vector<std::jthread> decoders;
+    for (unsigned int t = 0; t < decodeThreads; ++t) {
+      decoders.emplace_back([&]() {
+        try {
+          for (std::size_t i = nextImage++; i < images.size();
+               i = nextImage++) {
+            for (std::size_t done = learned; i >= done + window;
+                 done = learned) {
+              learned.wait(done);
+            }
+            const auto begin = Clock::now();
+            // con la cache un hit arriva gia' ridotto, un miss si riduce qui
+            Decoded item{i, cache ? abc::HopfieldImagePattern(
+                                        images[i], side, *cache)
+                                  : abc::HopfieldImagePattern(images[i], side)};
+            decodeTiming.add(Clock::now() - begin);
+            if (item.image.loadedFromCache()) {
+              ++cacheHits;
+            }
+            if (!decoded.push(std::move(item))) {
+              break;
+            }
+          }
+        } catch (...) {
+          error.set(std::current_exception());
+          stop();
+        }
+        decodeTiming.finish(start);
+        if (--decoding == 0) {
+          decoded.close();
+        }
+      });
+    }
+
+    // stadio 2: ridimensionamento bilineare e soglia
+    std::atomic<unsigned int> resizing{resizeThreads};
+    std::vector<std::jthread> resizers;
+    for (unsigned int t = 0; t < resizeThreads; ++t) {
+      resizers.emplace_back([&]() {
+        try {
+          while (auto item = decoded.pop()) {
+            const auto begin = Clock::now();
+            if (item->image.getPatternDimension() == 0) {
+              item->image.adaptImage_withBilinearInterpolation();
+            }
+            Binarized pattern{item->index, item->image.getPattern()};
+            resizeTiming.add(Clock::now() - begin);
+            if (!binarized.push(std::move(pattern))) {
+              break;
+            }
+          }
+        } catch (...) {
+          error.set(std::current_exception());
+          stop();
+        }
+        resizeTiming.finish(start);
+        if (--resizing == 0) {
+          binarized.close();
+        }
+      });
+    }
+
+    // stadio 3, in questo thread: i pattern arrivano in ordine sparso e si
+    // imparano nell'ordine della cartella, cosi' il file non dipende dai
+    // tempi dei thread. La finestra dei decodificatori limita pending
+    std::map<std::size_t, std::vector<int>> pending;
+    std::vector<std::vector<int>> block;
+    std::size_t nextIndex{0};
+    auto learnBlock = [&]() {
+      if (!block.empty()) {
+        classic->learnPatterns(block);
+        block.clear();
+      }
+    };
+    try {
+      while (auto item = binarized.pop()) {
+        const auto begin = Clock::now();
+        pending.emplace(item->index, std::move(item->pattern));
+        for (auto it = pending.find(nextIndex); it != pending.end();
+             it = pending.find(nextIndex)) {
+          if (classic) {
+            block.push_back(std::move(it->second));
+            if (block.size() == batch) {
+              learnBlock();
+            }
+          } else {
+            modern->learnPattern(it->second);
+          }
+          pending.erase(it);
+          ++nextIndex;
+          ++learnTiming.items;
+          // dopo stop() learned resta dov'e'
+          std::size_t previous{nextIndex - 1};
+          if (learned.compare_exchange_strong(previous, nextIndex)) {
+            learned.notify_all();
+          }
+        }
+        learnTiming.busyNanoseconds +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - begin)
+                .count();
+      }
+      const auto begin = Clock::now();
+      learnBlock();
+      learnTiming.busyNanoseconds +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               begin)
+              .count();
+    } catch (...) {
+      error.set(std::current_exception());
+      stop();
+    }
+    decoders.clear();
+    resizers.clear();
+    error.rethrow();
+    if (nextIndex == 0) {
+      throw std::runtime_error("No images found in the folder");
+    }
+
+    if (classic) {
+      classic->save(out, format);
+    } else {
+      modern->save(out, format);
+    }
+    learnTiming.finish(start);
+
+    std::cout << std::left << std::setw(10) << "stage" << std::setw(10)
+              << "threads" << std::setw(10) << "items" << std::setw(14)
+              << "busy [ms]" << "done at [ms]\n";
+    printStage("decode", decodeThreads, decodeTiming);
+    printStage("resize", resizeThreads, resizeTiming);
+    printStage("learn", 1, learnTiming);
+    if (cache) {
+      std::cout << cacheHits.load() << " patterns read from "
+                << cache->directory().string() << '\n';
+    }
+    std::cout << nextIndex << " patterns of " << side << " x " << side
+              << " written to " << out << '\n';
+  } catch (std::exception const& e) {
+    std::cerr << "Caught exception: '" << e.what() << "'\n";
+    std::cerr << kUsage;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Caught unknown exception\n";
+    return EXIT_FAILURE;
+  }
+}
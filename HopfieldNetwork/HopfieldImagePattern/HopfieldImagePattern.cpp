@@ -5,6 +5,9 @@
 #include <cassert>
 #include <cmath>
 #include <random>
+
+#include "../Matrix/ImageKernels.hpp"
+#include "../Matrix/Random.hpp"
  
 // Costructors
 namespace abc {
@@ -17,6 +20,26 @@ HopfieldImagePattern::HopfieldImagePattern(const std::string& filepath,
   setInImage(filepath);
   setImageDimension(sqrtDim);
 }
+HopfieldImagePattern::HopfieldImagePattern(const std::string& filepath,
+                                           unsigned int sqrtDim,
+                                           const PatternCache& cache,
+                                           ResizeMethod method)
+    : imageDimension_{sqrtDim} {
+  const PatternKey key{patternKey(filepath, sqrtDim, method)};
+  if (const auto cached = cache.find(key);
+      cached && cached->size() == sqrtDim * sqrtDim) {
+    pattern_ = cached->toVector();
+    fromCache_ = true;
+    return;
+  }
+  setInImage(filepath);
+  if (method == ResizeMethod::Area) {
+    adaptImage_withSFML();
+  } else {
+    adaptImage_withBilinearInterpolation();
+  }
+  cache.store(key, getBitPattern());
+}
 
 // setter
 void HopfieldImagePattern::setInImage(const sf::Image& image) {
@@ -51,6 +74,11 @@ std::vector<int> HopfieldImagePattern::getPattern_for_testing() const {
   return pattern_;
 }
 
+BitPattern HopfieldImagePattern::getBitPattern() const {
+  checkPatternDimension();
+  return BitPattern(pattern_);
+}
+
 // other methods
 void HopfieldImagePattern::checkPatternDimension() const {
   if (pattern_.empty()) {
@@ -62,25 +90,23 @@ void HopfieldImagePattern::checkPatternDimension() const {
 }
 sf::Image HopfieldImagePattern::printPattern() const {
   checkPatternDimension();
-
+  // tutti i pixel in un buffer e una sola create, invece di un setPixel per
+  // pixel
+  std::vector<std::uint8_t> rgba(pattern_.size() * 4);
+  renderPattern(pattern_, rgba);
   sf::Image patternVisualization;
-  patternVisualization.create(imageDimension_, imageDimension_,
-                              sf::Color::Transparent);
-
-  for (unsigned int y = 0; y < imageDimension_; ++y) {
-    for (unsigned int x = 0; x < imageDimension_; ++x) {
-      if (pattern_[y * imageDimension_ + x] == 1) {
-        patternVisualization.setPixel(x, y, sf::Color::Black);
-      } else {
-        patternVisualization.setPixel(x, y, sf::Color::White);
-      }
-    }
-  }
-
+  patternVisualization.create(imageDimension_, imageDimension_, rgba.data());
   return patternVisualization;
 }
-double HopfieldImagePattern::getAdaptedPixel(const sf::Color& pixel) const {
-  return (pixel.r + pixel.g + pixel.b) / 3.0;
+void HopfieldImagePattern::updateTexture(sf::Texture& texture) const {
+  checkPatternDimension();
+  if (texture.getSize() != sf::Vector2u(imageDimension_, imageDimension_) &&
+      !texture.create(imageDimension_, imageDimension_)) {
+    throw std::runtime_error("Cannot create the texture!");
+  }
+  rgba_.resize(pattern_.size() * 4);
+  renderPattern(pattern_, rgba_);
+  texture.update(rgba_.data());
 }
 
 // methods to elaborate the pattern
@@ -99,102 +125,114 @@ void HopfieldImagePattern::cutPattern(unsigned int pixel_x,
   }
   checkPatternDimension();
 }
+void HopfieldImagePattern::occlude(unsigned int pixel_x,
+                                   unsigned int pixel_y, unsigned int width,
+                                   unsigned int height) {
+  checkPatternDimension();
+  if (pixel_x >= imageDimension_ || pixel_y >= imageDimension_) {
+    throw std::runtime_error(
+        "invalid starting point, it exceeds the pattern dimension!");
+  }
+  const unsigned int xEnd{pixel_x + std::min(width, imageDimension_ - pixel_x)};
+  const unsigned int yEnd{pixel_y +
+                          std::min(height, imageDimension_ - pixel_y)};
+  for (unsigned int y = pixel_y; y < yEnd; ++y) {
+    std::fill(pattern_.begin() + y * imageDimension_ + pixel_x,
+              pattern_.begin() + y * imageDimension_ + xEnd, 1);
+  }
+}
 void HopfieldImagePattern::corrupt(long unsigned int nPixel) {
+  std::random_device rd;  // a seed source for the random number generator
+  corrupt(nPixel, (static_cast<std::uint64_t>(rd()) << 32) | rd());
+}
+void HopfieldImagePattern::corrupt(long unsigned int nPixel,
+                                   std::uint64_t seed) {
   checkPatternDimension();
   if (nPixel > imageDimension_ * imageDimension_) {
     throw std::runtime_error(
         "Cannot corrupt more pixels than the pattern contains.");
   }
-
-  std::vector<unsigned int> indices(pattern_.size());
-  std::iota(indices.begin(), indices.end(), 0);
-
-  std::random_device rd;   // a seed source for the random number engine
-  std::mt19937 gen(rd());  // mersenne_twister_engine seeded with rd()
-  std::shuffle(indices.begin(), indices.end(), gen);
-
-  for (long unsigned int i = 0; i < nPixel; ++i) {
-    pattern_[indices[i]] *= -1;
-  }
-
+  // solo nPixel estrazioni: il buffer del sampler resta fra le chiamate
+  thread_local DistinctSampler sampler;
+  Xoshiro256 generator(seed);
+  sampler.sample(pattern_.size(), nPixel, generator,
+                 [&](std::size_t i) { pattern_[i] = -pattern_[i]; });
+}
+void HopfieldImagePattern::corruptBlocks(unsigned int blockSide,
+                                         long unsigned int nBlocks,
+                                         std::uint64_t seed) {
   checkPatternDimension();
-}
-
-// methods to create pattern(private)
-void HopfieldImagePattern::createBinaryPattern(const sf::Image& img) {
-  for (unsigned int y = 0; y < img.getSize().y; ++y) {
-    for (unsigned int x = 0; x < img.getSize().x; ++x) {
-      pattern_.push_back(getAdaptedPixel(img.getPixel(x, y)) < 127 ? 1 : -1);
-    }
+  if (blockSide == 0) {
+    throw std::runtime_error("The block side must be positive.");
   }
+  // griglia di blocchi; quelli dell'ultima riga e colonna possono essere
+  // piu' piccoli
+  const unsigned int tiles{(imageDimension_ + blockSide - 1) / blockSide};
+  if (nBlocks > static_cast<long unsigned int>(tiles) * tiles) {
+    throw std::runtime_error(
+        "Cannot corrupt more blocks than the pattern contains.");
+  }
+  thread_local DistinctSampler sampler;
+  Xoshiro256 generator(seed);
+  sampler.sample(
+      static_cast<std::size_t>(tiles) * tiles, nBlocks, generator,
+      [&](std::size_t tile) {
+        const auto x0 = static_cast<unsigned int>(tile % tiles) * blockSide;
+        const auto y0 = static_cast<unsigned int>(tile / tiles) * blockSide;
+        const unsigned int xEnd{std::min(x0 + blockSide, imageDimension_)};
+        const unsigned int yEnd{std::min(y0 + blockSide, imageDimension_)};
+        for (unsigned int y = y0; y < yEnd; ++y) {
+          for (unsigned int x = x0; x < xEnd; ++x) {
+            pattern_[y * imageDimension_ + x] *= -1;
+          }
+        }
+      });
 }
 
 // methods to shrink images (questi non hanno throws perchè sono già ceckatti
 // prima in setInImage)
 sf::Image HopfieldImagePattern::adaptImage_withSFML() {
-  sf::Texture o_Texture;
-  o_Texture.loadFromImage(
-    inImage_); // per essere caricata l'immagine passa da setInImage, dove
-                   // sono già presenti dei throw
-  o_Texture.setSmooth(true);
-
-  sf::Sprite sprite;
-  sprite.setTexture(o_Texture);
-  sprite.setScale(static_cast<float>(imageDimension_) /
-                      static_cast<float>(inImage_.getSize().x),
-                  static_cast<float>(imageDimension_) /
-                      static_cast<float>(inImage_.getSize().y));
-
-  sf::RenderTexture final_render;
-  final_render.create(imageDimension_, imageDimension_);
-  final_render.clear(sf::Color::Transparent);
-  final_render.draw(sprite);
-  final_render.display();
-
-  createBinaryPattern(final_render.getTexture().copyToImage());
-
-  // assert to avoid error on size of the pattern
-  assert(pattern_.size() == imageDimension_ * imageDimension_);
+  // media sulle aree calcolata dalla CPU direttamente sui pixel: prima si
+  // disegnava uno sprite in una RenderTexture, che richiede un contesto
+  // OpenGL (assente sui server) e due copie dalla GPU
+  const sf::Vector2u size{inImage_.getSize()};
+  if (size.x == 0 || size.y == 0) {
+    throw std::runtime_error(
+        "Input image not loaded, please check input path.");
+  }
+  std::vector<std::uint8_t> resized(imageDimension_ * imageDimension_ * 4);
+  pattern_.resize(imageDimension_ * imageDimension_);
+  areaAverageThreshold(inImage_.getPixelsPtr(), size.x, size.y,
+                       imageDimension_, resized,
+                       [&](std::size_t i, int spin) { pattern_[i] = spin; });
 
-  return final_render.getTexture().copyToImage();
+  sf::Image adapted;
+  adapted.create(imageDimension_, imageDimension_, resized.data());
+  return adapted;
 }
 void HopfieldImagePattern::adaptImage_withBilinearInterpolation() {
-  unsigned int img_width = inImage_.getSize().x;
-  unsigned int img_height = inImage_.getSize().y;
-
-  double x_ratio = (img_width - 1) / static_cast<double>(imageDimension_ - 1);
-  double y_ratio = (img_height - 1) / static_cast<double>(imageDimension_ - 1);
-
-  for (unsigned int y = 0; y < imageDimension_; ++y) {
-    for (unsigned int x = 0; x < imageDimension_; ++x) {
-      double gx = x_ratio * x;
-      double gy = y_ratio * y;
-
-      unsigned int x_l = static_cast<unsigned int>(std::floor(gx));
-      unsigned int x_h = std::min(static_cast<unsigned int>(std::ceil(gx)),
-                                  static_cast<unsigned int>(img_width - 1));
-      unsigned int y_l = static_cast<unsigned int>(std::floor(gy));
-      unsigned int y_h = std::min(static_cast<unsigned int>(std::ceil(gy)),
-                                  static_cast<unsigned int>(img_height - 1));
-
-      double x_weight{gx - x_l};
-      double y_weight{gy - y_l};
-
-      sf::Color a = inImage_.getPixel(x_l, y_l);
-      sf::Color b = inImage_.getPixel(x_h, y_l);
-      sf::Color c = inImage_.getPixel(x_l, y_h);
-      sf::Color d = inImage_.getPixel(x_h, y_h);
-
-      double pixel = getAdaptedPixel(a) * (1 - x_weight) * (1 - y_weight) +
-                     getAdaptedPixel(b) * (x_weight) * (1 - y_weight) +
-                     getAdaptedPixel(c) * (1 - x_weight) * (y_weight) +
-                     getAdaptedPixel(d) * (x_weight) * (y_weight);
-
-      pattern_.push_back(pixel < 127 ? 1 : -1);
-    }
+  // il pattern si sovrascrive: una seconda chiamata non lo allunga
+  pattern_.resize(imageDimension_ * imageDimension_);
+  resizeBilinear([&](std::size_t i, int spin) { pattern_[i] = spin; });
+}
+void HopfieldImagePattern::adaptImage_withBilinearInterpolation(
+    BitPattern& out) const {
+  if (out.size() != imageDimension_ * imageDimension_) {
+    out = BitPattern(imageDimension_ * imageDimension_);
   }
-
-  // assert to avoid error making pattern
-  assert(pattern_.size() == imageDimension_ * imageDimension_);
+  resizeBilinear([&](std::size_t i, int spin) { out.set(i, spin); });
+}
+template <class Store>
+void HopfieldImagePattern::resizeBilinear(Store store) const {
+  const sf::Vector2u size{inImage_.getSize()};
+  if (size.x == 0 || size.y == 0) {
+    throw std::runtime_error(
+        "Input image not loaded, please check input path.");
+  }
+  // tabelle e righe restano fra le immagini dello stesso thread, che di
+  // solito hanno tutte la stessa dimensione
+  thread_local BilinearResampler resampler;
+  resampler.resize(inImage_.getPixelsPtr(), size.x, size.y, imageDimension_,
+                   store);
 }
 }  // namespace abc
\ No newline at end of file
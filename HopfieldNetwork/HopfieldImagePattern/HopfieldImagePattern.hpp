@@ -2,9 +2,13 @@
 #define HOPFIELDNEURALNETWORK_HOPFIELDIMAGEPATTERN_H
 
 #include <SFML/Graphics.hpp>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "../Matrix/BitPattern.hpp"
+#include "../Matrix/PatternCache.hpp"
+
 // il class invariant è la dimensione di pattern una volta creato
 
 namespace abc {
@@ -13,18 +17,26 @@ class HopfieldImagePattern {
   sf::Image inImage_;
   unsigned int imageDimension_{100};
   std::vector<int> pattern_;
+  bool fromCache_{false};
+  mutable std::vector<std::uint8_t> rgba_;  // pixel di updateTexture, riusati
 
   // private methods
-  double getAdaptedPixel(
-      const sf::Color &pixel) const;               // tested the consequences
-  void createBinaryPattern(const sf::Image &img);  // tested the consequences
   void checkPatternDimension() const;              // check class invariant
+  template <class Store>
+  void resizeBilinear(Store store) const;  // store(i, spin) per ogni pixel
 
  public:
   // constructor
   HopfieldImagePattern(const std::string &filepath);
   HopfieldImagePattern(const std::string &filepath,
                        unsigned int sqrtPattrnDimension);
+  // the pattern is looked up in the cache before decoding the image: on a
+  // hit inImage_ stays empty and the pattern is ready, on a miss the image
+  // is decoded, adapted with method and stored
+  HopfieldImagePattern(const std::string &filepath,
+                       unsigned int sqrtPattrnDimension,
+                       const PatternCache &cache,
+                       ResizeMethod method = ResizeMethod::Bilinear);
 
   // setter
   void setInImage(const std::string &filepath);
@@ -40,19 +52,36 @@ class HopfieldImagePattern {
   long unsigned int getPatternDimension() const;
   const std::vector<int> &getPattern() const;
   std::vector<int> getPattern_for_testing() const;
+  BitPattern getBitPattern() const;  // pattern a 1 bit per pixel
+  bool loadedFromCache() const { return fromCache_; }
 
   sf::Image printPattern() const;
+  // same pixels as printPattern written into texture (created with the
+  // pattern size if needed): after the first call nothing is allocated
+  void updateTexture(sf::Texture &texture) const;
 
   // other methods
   void cutPattern(unsigned int pixel_x,
                   unsigned int pixel_y);  // cut pattern fromWhere - 1 till end
                                           // (set pixel to black)
+  // black rectangle from (pixel_x, pixel_y), clipped to the image
+  void occlude(unsigned int pixel_x, unsigned int pixel_y, unsigned int width,
+               unsigned int height);
+  // flips nPixel distinct pixels; with a seed the choice is repeatable
   void corrupt(long unsigned int nPixel);
+  void corrupt(long unsigned int nPixel, std::uint64_t seed);
+  // flips every pixel of nBlocks distinct tiles of a blockSide grid
+  void corruptBlocks(unsigned int blockSide, long unsigned int nBlocks,
+                     std::uint64_t seed);
 
-  // these methods adapt inImage to the size given and they use
-  // createBinaryPattern() to load pattern_
+  // these methods adapt inImage to the size given and load pattern_
+  // (dark pixel -> 1). adaptImage_withSFML averages the covered areas on
+  // the CPU (no OpenGL context needed) and returns the resized image.
+  // The bilinear overload with a BitPattern fills it (resized if needed)
+  // without touching pattern_
   sf::Image adaptImage_withSFML();
   void adaptImage_withBilinearInterpolation();
+  void adaptImage_withBilinearInterpolation(BitPattern &out) const;
 };
 }  // namespace abc
 
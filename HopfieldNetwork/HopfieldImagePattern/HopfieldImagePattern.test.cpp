@@ -2,6 +2,7 @@
 
 #include "HopfieldImagePattern.hpp"
 
+#include "../Matrix/TempFile.hpp"
 #include "../doctest.h"
 
 TEST_CASE("Testing Constructors") {
@@ -26,6 +27,29 @@ TEST_CASE("Testing Constructors") {
     CHECK(pattern.getImageDimension() == 20);
   };
 }
+TEST_CASE("Testing the pattern cache") {
+  const std::string image{"../HopfieldImagePattern/images/orecchino.png"};
+  const abc::TempFile directory("pattern_cache_test");
+  const abc::PatternCache cache(directory.path());
+
+  abc::HopfieldImagePattern first(image, 8, cache);
+  CHECK_FALSE(first.loadedFromCache());
+  REQUIRE(first.getPatternDimension() == 64);
+
+  // la seconda volta l'immagine non si decodifica
+  abc::HopfieldImagePattern second(image, 8, cache);
+  CHECK(second.loadedFromCache());
+  CHECK(second.get_inImage().getSize().x == 0);
+  CHECK(second.getPattern() == first.getPattern());
+
+  // altro lato o altro metodo: altra voce
+  abc::HopfieldImagePattern other(image, 8, cache, abc::ResizeMethod::Area);
+  CHECK_FALSE(other.loadedFromCache());
+
+  CHECK_THROWS_WITH_AS(abc::HopfieldImagePattern("nullFile.png", 8, cache),
+                       "Input image not loaded, please check input path.",
+                       std::runtime_error);
+}
 TEST_CASE("Testing HopfieldImagePattern functions") {
   abc::HopfieldImagePattern pattern(
       "../HopfieldImagePattern/images/orecchino.png",
@@ -51,6 +75,12 @@ TEST_CASE("Testing HopfieldImagePattern functions") {
     CHECK(createdPattern ==
           expectedPattern);  // using overload of operator== for std::vector
   }
+  SUBCASE("Testing adapting algorithm - with SFML returns the resized image") {
+    sf::Image resized = pattern.adaptImage_withSFML();
+    CHECK(resized.getSize().x == 2);
+    CHECK(resized.getSize().y == 2);
+    CHECK(resized.getPixel(1, 1) == sf::Color(100, 100, 100));
+  }
   SUBCASE("Testing adapting algorithm - with bilinear interpolation") {
     pattern.adaptImage_withBilinearInterpolation();
     CHECK(pattern.getPatternDimension() == 4);
@@ -58,6 +88,16 @@ TEST_CASE("Testing HopfieldImagePattern functions") {
     CHECK(createdPattern ==
           expectedPattern);  // using overload of operator== for std::vector
   }
+  SUBCASE("Testing adapting algorithm - bilinear into a BitPattern") {
+    abc::BitPattern bits;
+    pattern.adaptImage_withBilinearInterpolation(bits);
+    CHECK(bits.toVector() == expectedPattern);
+    CHECK(pattern.getPatternDimension() == 0);
+    // una seconda chiamata sovrascrive il pattern, non lo allunga
+    pattern.adaptImage_withBilinearInterpolation();
+    pattern.adaptImage_withBilinearInterpolation();
+    CHECK(pattern.getPattern() == expectedPattern);
+  }
   SUBCASE(
       "Testing printPattern - whether the function actually print the "
       "pattern") {
@@ -73,6 +113,21 @@ TEST_CASE("Testing HopfieldImagePattern functions") {
     CHECK(result.getPixel(0, 1) == sf::Color::White);
     CHECK(result.getPixel(1, 1) == sf::Color::Black);
   }
+  SUBCASE("Testing updateTexture - same pixels as printPattern") {
+    pattern.adaptImage_withBilinearInterpolation();
+    sf::Texture texture;
+    pattern.updateTexture(texture);  // la crea della dimensione giusta
+    REQUIRE(texture.getSize().x == 2);
+    sf::Image result = texture.copyToImage();
+    CHECK(result.getPixel(0, 0) == sf::Color::White);
+    CHECK(result.getPixel(1, 0) == sf::Color::Black);
+
+    pattern.elaboratePattern()[0] = 1;
+    pattern.updateTexture(texture);
+    result = texture.copyToImage();
+    CHECK(result.getPixel(0, 0) == sf::Color::Black);
+    CHECK(result.getPixel(0, 0) == pattern.printPattern().getPixel(0, 0));
+  }
   SUBCASE("Testing printPattern - error pattern empty while printing it") {
     CHECK_THROWS_WITH_AS(pattern.printPattern(),
                          "Cannot access or modify the pattern because it has "
@@ -145,6 +200,50 @@ TEST_CASE("Testing HopfieldImagePattern functions") {
         "Cannot corrupt more pixels than the pattern contains.",
         std::runtime_error);
   }
+  SUBCASE("Testing corrupt - same seed, same pixels") {
+    pattern.adaptImage_withSFML();
+    const auto original = pattern.getPattern();
+    pattern.corrupt(2, 42);
+    const auto first = pattern.getPattern();
+    pattern.elaboratePattern() = original;
+    pattern.corrupt(2, 42);
+    CHECK(pattern.getPattern() == first);
+    int diffCount = 0;
+    for (unsigned int i = 0; i < 4; ++i) {
+      diffCount += original[i] != first[i] ? 1 : 0;
+    }
+    CHECK(diffCount == 2);
+  }
+  SUBCASE("Testing corruptBlocks - whole tiles are flipped") {
+    pattern.adaptImage_withSFML();
+    pattern.corruptBlocks(2, 1, 7);  // un solo blocco: tutto il pattern
+    CHECK(pattern.getPattern() == std::vector<int>{1, -1, 1, -1});
+    pattern.corruptBlocks(1, 4, 7);  // blocchi da un pixel: tutti
+    CHECK(pattern.getPattern() == expectedPattern);
+    CHECK_THROWS_WITH_AS(
+        pattern.corruptBlocks(1, 5, 7),
+        "Cannot corrupt more blocks than the pattern contains.",
+        std::runtime_error);
+    CHECK_THROWS_WITH_AS(pattern.corruptBlocks(0, 1, 7),
+                         "The block side must be positive.",
+                         std::runtime_error);
+  }
+  SUBCASE("Testing occlude - black rectangle clipped to the image") {
+    pattern.adaptImage_withSFML();
+    pattern.occlude(0, 1, 1, 5);
+    CHECK(pattern.getPattern() == std::vector<int>{-1, 1, 1, 1});
+    CHECK_THROWS_WITH_AS(
+        pattern.occlude(2, 0, 1, 1),
+        "invalid starting point, it exceeds the pattern dimension!",
+        std::runtime_error);
+  }
+
+  SUBCASE("Testing getBitPattern - same spins packed in bits") {
+    pattern.adaptImage_withBilinearInterpolation();
+    abc::BitPattern packed = pattern.getBitPattern();
+    CHECK(packed.size() == 4);
+    CHECK(packed.toVector() == expectedPattern);
+  }
 
   // pattern elaborator
   SUBCASE("Testing patterElaborator - passing the right pattern ") {
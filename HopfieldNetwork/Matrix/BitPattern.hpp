@@ -0,0 +1,156 @@
+#ifndef HOPFIELDNEURALNETWORK_BITPATTERN_H
+#define HOPFIELDNEURALNETWORK_BITPATTERN_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace abc {
+
+// numero di parole da 64 bit per n spin
+inline std::size_t bitWords(std::size_t n) { return (n + 63) / 64; }
+
+// <a, b> fra pattern +-1 impacchettati su n bit: n - 2 * popcount(a xor b).
+// I bit oltre n devono essere a zero in entrambi
+inline int bitDot(std::span<const std::uint64_t> a,
+                  std::span<const std::uint64_t> b, std::size_t n) {
+  int different{0};
+  for (std::size_t w = 0; w < a.size(); ++w) {
+    different += std::popcount(a[w] ^ b[w]);
+  }
+  return static_cast<int>(n) - 2 * different;
+}
+
+// lo spin i vale +1 se il bit i e' a uno, -1 altrimenti
+inline int bitSpin(std::span<const std::uint64_t> words, std::size_t i) {
+  return (words[i / 64] >> (i % 64)) & 1u ? 1 : -1;
+}
+
+// pattern di spin +-1 impacchettato in parole da 64 bit (1 bit per spin)
+class BitPattern {
+ private:
+  std::vector<std::uint64_t> words_;
+  std::size_t size_{0};
+
+ public:
+  BitPattern() {}
+  // tutti gli spin a -1
+  explicit BitPattern(std::size_t size) : words_(bitWords(size)), size_{size} {}
+  explicit BitPattern(std::span<const int> pattern)
+      : words_(bitWords(pattern.size())), size_{pattern.size()} {
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (pattern[i] > 0) {
+        words_[i / 64] |= std::uint64_t{1} << (i % 64);
+      }
+    }
+  }
+
+  // dalle parole gia' impacchettate (ad esempio lette da un file); i bit
+  // oltre size si azzerano
+  BitPattern(std::size_t size, std::span<const std::uint64_t> words)
+      : words_(words.begin(), words.end()), size_{size} {
+    if (words_.size() != bitWords(size)) {
+      throw std::runtime_error("Bit patterns sizes do not match!");
+    }
+    if (size % 64 != 0) {
+      words_.back() &= (std::uint64_t{1} << (size % 64)) - 1;
+    }
+  }
+
+  std::size_t size() const { return size_; }
+  std::span<const std::uint64_t> words() const { return words_; }
+
+  int operator[](std::size_t i) const { return bitSpin(words_, i); }
+  void set(std::size_t i, int value) {
+    const std::uint64_t mask{std::uint64_t{1} << (i % 64)};
+    if (value > 0) {
+      words_[i / 64] |= mask;
+    } else {
+      words_[i / 64] &= ~mask;
+    }
+  }
+  void flip(std::size_t i) { words_[i / 64] ^= std::uint64_t{1} << (i % 64); }
+
+  std::vector<int> toVector() const {
+    std::vector<int> pattern(size_);
+    for (std::size_t i = 0; i < size_; ++i) {
+      pattern[i] = (*this)[i];
+    }
+    return pattern;
+  }
+
+  bool operator==(const BitPattern& other) const = default;
+};
+
+inline int dot(const BitPattern& a, const BitPattern& b) {
+  if (a.size() != b.size()) {
+    throw std::runtime_error("Bit patterns sizes do not match!");
+  }
+  return bitDot(a.words(), b.words(), a.size());
+}
+
+// pattern impacchettati per neurone (trasposti): la colonna i contiene lo
+// spin i di tutti i pattern, un bit per pattern, in parole contigue. Serve a
+// chi legge lo stesso neurone di molti pattern (gli aggiornamenti per
+// coordinata), che altrimenti salterebbe da un pattern all'altro
+class BitColumns {
+ private:
+  std::vector<std::uint64_t> words_;
+  std::size_t neurons_{0};
+  std::size_t patterns_{0};
+  std::size_t stride_{0};  // parole riservate per colonna
+
+ public:
+  BitColumns() {}
+  explicit BitColumns(std::size_t neurons) : neurons_{neurons} {}
+
+  std::size_t neurons() const { return neurons_; }
+  std::size_t size() const { return patterns_; }
+  // bitSpin(column(i), p) e' lo spin i del pattern p
+  std::span<const std::uint64_t> column(std::size_t i) const {
+    return {words_.data() + i * stride_, bitWords(patterns_)};
+  }
+
+  // nessun pattern; lo spazio riservato resta
+  void clear() {
+    std::fill(words_.begin(), words_.end(), 0);
+    patterns_ = 0;
+  }
+  void append(std::span<const std::uint64_t> pattern) {
+    if (pattern.size() != bitWords(neurons_)) {
+      throw std::runtime_error("Bit patterns sizes do not match!");
+    }
+    if (bitWords(patterns_ + 1) > stride_) {
+      // capacita' raddoppiata: O(N) ammortizzato per pattern
+      const std::size_t stride{std::max<std::size_t>(1, 2 * stride_)};
+      std::vector<std::uint64_t> words(neurons_ * stride);
+      for (std::size_t i = 0; i < neurons_; ++i) {
+        std::copy_n(words_.begin() + static_cast<std::ptrdiff_t>(i * stride_),
+                    stride_,
+                    words.begin() + static_cast<std::ptrdiff_t>(i * stride));
+      }
+      words_ = std::move(words);
+      stride_ = stride;
+    }
+    const std::uint64_t bit{std::uint64_t{1} << (patterns_ % 64)};
+    const std::size_t word{patterns_ / 64};
+    // solo i neuroni a +1: si scorrono i bit accesi
+    for (std::size_t w = 0; w < pattern.size(); ++w) {
+      for (std::uint64_t ones = pattern[w]; ones != 0; ones &= ones - 1) {
+        const std::size_t i{w * 64 +
+                            static_cast<std::size_t>(std::countr_zero(ones))};
+        words_[i * stride_ + word] |= bit;
+      }
+    }
+    ++patterns_;
+  }
+};
+
+}  // namespace abc
+
+#endif
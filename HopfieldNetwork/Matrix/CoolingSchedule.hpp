@@ -0,0 +1,120 @@
+#ifndef HOPFIELDNEURALNETWORK_COOLINGSCHEDULE_H
+#define HOPFIELDNEURALNETWORK_COOLINGSCHEDULE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <variant>
+
+namespace abc {
+
+// temperatura di uno sweep e il suo reciproco: nei loop interni si
+// moltiplica per inverse invece di dividere per value
+struct Temperature {
+  double value;
+  double inverse;  // +inf a temperatura nulla
+};
+
+// politiche di raffreddamento: temperature(t0, iter) e' la temperatura dello
+// sweep iter partendo da t0
+
+// t0 / log(2 + iter), lenta ma con garanzie di convergenza
+struct LogarithmicCooling {
+  double temperature(double t0, int iter) const {
+    if (iter == 0) {
+      return t0;
+    }
+    return static_cast<float>(t0 * (1 / std::log(2 + iter)));
+  }
+};
+// t0 * rate^iter
+struct GeometricCooling {
+  double rate{0.8};
+  double temperature(double t0, int iter) const {
+    return t0 * std::pow(rate, iter);
+  }
+};
+// t0 - step * iter, fino a zero
+struct LinearCooling {
+  double step{0.9};
+  double temperature(double t0, int iter) const {
+    return std::max(0.0, t0 - step * iter);
+  }
+};
+// raffredda piano finche' molte mosse vengono accettate e in fretta quando
+// il sistema si e' calmato: observe() riceve la frazione di neuroni cambiati
+// nell'ultimo sweep, reset() fa ripartire la corsa da t0
+struct AdaptiveCooling {
+  double fastRate{0.8};
+  double slowRate{0.95};
+  double targetAcceptance{0.05};
+  double current{0.0};
+
+  double temperature(double, int) const { return current; }
+  void reset(double t0) { current = t0; }
+  void observe(double acceptedFraction) {
+    current *= acceptedFraction > targetAcceptance ? slowRate : fastRate;
+  }
+};
+
+using CoolingPolicy = std::variant<LogarithmicCooling, GeometricCooling,
+                                   LinearCooling, AdaptiveCooling>;
+
+// politica scelta e temperatura iniziale. at() non cambia nulla: chi la usa
+// in un loop la chiede una volta per sweep e tiene il risultato, cosi' il
+// logaritmo o la potenza si calcolano una volta sola. Lo stato della
+// politica adattiva cambia solo con reset() e observe()
+class Cooling {
+ private:
+  CoolingPolicy policy_;
+  double t0_;
+
+  static Temperature make(double value) {
+    if (value < 0.01) {
+      value = 0.0;
+    }
+    return {value, value > 0.0 ? 1.0 / value
+                               : std::numeric_limits<double>::infinity()};
+  }
+
+ public:
+  explicit Cooling(double t0, CoolingPolicy policy = LogarithmicCooling{})
+      : policy_{policy}, t0_{t0} {
+    reset();
+  }
+
+  void setPolicy(CoolingPolicy policy) {
+    policy_ = policy;
+    reset();
+  }
+  void setT0(double t0) {
+    t0_ = t0;
+    reset();
+  }
+  double t0() const { return t0_; }
+  // temperatura dello sweep 0 (t0 per ogni politica), anche a corsa
+  // adattiva iniziata
+  Temperature base() const { return make(t0_); }
+
+  Temperature at(int iter) const {
+    return make(std::visit(
+        [&](const auto& policy) { return policy.temperature(t0_, iter); },
+        policy_));
+  }
+  // da chiamare una volta all'inizio di un annealing
+  void reset() {
+    if (auto* adaptive = std::get_if<AdaptiveCooling>(&policy_)) {
+      adaptive->reset(t0_);
+    }
+  }
+  // da chiamare a fine sweep di annealing
+  void observe(double acceptedFraction) {
+    if (auto* adaptive = std::get_if<AdaptiveCooling>(&policy_)) {
+      adaptive->observe(acceptedFraction);
+    }
+  }
+};
+
+}  // namespace abc
+
+#endif
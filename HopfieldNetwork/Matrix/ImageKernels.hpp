@@ -0,0 +1,242 @@
+#ifndef HOPFIELDNEURALNETWORK_IMAGEKERNELS_H
+#define HOPFIELDNEURALNETWORK_IMAGEKERNELS_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "BitPattern.hpp"
+
+namespace abc {
+
+// kernel sui pixel grezzi (RGBA, 4 byte per pixel, righe contigue come in
+// sf::Image::getPixelsPtr()), senza SFML: il pattern di un'immagine
+// quadrata dim x dim si scrive direttamente, pixel scuro -> +1
+
+// soglia del pattern: media dei tre canali < 127, cioe' r + g + b < 381
+inline constexpr int kDarkSum{3 * 127};
+
+// pesi di un asse per la media sulle aree: il pixel di destinazione i copre
+// l'intervallo [i, i + 1) * src / dst della sorgente, e ogni pixel sorgente
+// pesa per la parte coperta
+struct AreaAxis {
+  std::vector<std::size_t> first;   // primo pixel sorgente
+  std::vector<std::size_t> offset;  // pesi di i: weights[offset[i]...]
+  std::vector<float> weights;
+
+  AreaAxis(std::size_t src, std::size_t dst) : first(dst), offset(dst + 1) {
+    const double scale{static_cast<double>(src) / static_cast<double>(dst)};
+    for (std::size_t i = 0; i < dst; ++i) {
+      const double begin{static_cast<double>(i) * scale};
+      const double end{static_cast<double>(i + 1) * scale};
+      first[i] = static_cast<std::size_t>(begin);
+      offset[i] = weights.size();
+      for (std::size_t j = first[i]; j < src && static_cast<double>(j) < end;
+           ++j) {
+        const double covered{std::min(end, static_cast<double>(j + 1)) -
+                             std::max(begin, static_cast<double>(j))};
+        weights.push_back(static_cast<float>(covered / scale));
+      }
+    }
+    offset[dst] = weights.size();
+  }
+  std::size_t count(std::size_t i) const { return offset[i + 1] - offset[i]; }
+};
+
+// riduce (o ingrandisce) l'immagine a dim x dim con la media sulle aree,
+// separabile: prima le righe sorgente di ogni riga di destinazione (un loop
+// contiguo su tutta la riga, che il compilatore vettorizza), poi le colonne.
+// resized riceve l'immagine RGBA ridotta, store(i, spin) il pattern
+template <class Store>
+void areaAverageThreshold(const std::uint8_t* pixels, std::size_t width,
+                          std::size_t height, std::size_t dim,
+                          std::span<std::uint8_t> resized, Store store) {
+  const AreaAxis xAxis(width, dim);
+  const AreaAxis yAxis(height, dim);
+  std::vector<float> row(width * 4);
+  for (std::size_t y = 0; y < dim; ++y) {
+    std::fill(row.begin(), row.end(), 0.0f);
+    for (std::size_t k = 0; k < yAxis.count(y); ++k) {
+      const float w{yAxis.weights[yAxis.offset[y] + k]};
+      const std::uint8_t* source = pixels + (yAxis.first[y] + k) * width * 4;
+      for (std::size_t c = 0; c < width * 4; ++c) {
+        row[c] += w * static_cast<float>(source[c]);
+      }
+    }
+    for (std::size_t x = 0; x < dim; ++x) {
+      float sum[4]{0.0f, 0.0f, 0.0f, 0.0f};
+      for (std::size_t k = 0; k < xAxis.count(x); ++k) {
+        const float w{xAxis.weights[xAxis.offset[x] + k]};
+        const float* source = row.data() + (xAxis.first[x] + k) * 4;
+        for (std::size_t c = 0; c < 4; ++c) {
+          sum[c] += w * source[c];
+        }
+      }
+      std::uint8_t* target = resized.data() + (y * dim + x) * 4;
+      for (std::size_t c = 0; c < 4; ++c) {
+        target[c] = static_cast<std::uint8_t>(
+            std::clamp(std::lround(sum[c]), 0l, 255l));
+      }
+      // la soglia si applica ai byte scritti, come se si rileggesse resized
+      store(y * dim + x,
+            target[0] + target[1] + target[2] < kDarkSum ? 1 : -1);
+    }
+  }
+}
+
+// interpolazione bilineare separabile con soglia. Le tabelle degli indici e
+// dei pesi si calcolano una volta per dimensione (sorgente, destinazione) e
+// restano per le immagini successive: conviene tenerne una per thread
+class BilinearResampler {
+ private:
+  // un asse: come in adaptImage_withBilinearInterpolation,
+  // g = i * (src - 1) / (dst - 1), fra floor(g) e ceil(g)
+  struct Axis {
+    std::vector<std::size_t> low;
+    std::vector<std::size_t> high;
+    std::vector<float> weight;  // peso di high
+
+    void build(std::size_t src, std::size_t dst) {
+      low.resize(dst);
+      high.resize(dst);
+      weight.resize(dst);
+      const double ratio{dst > 1 ? static_cast<double>(src - 1) /
+                                       static_cast<double>(dst - 1)
+                                 : 0.0};
+      for (std::size_t i = 0; i < dst; ++i) {
+        const double g{ratio * static_cast<double>(i)};
+        low[i] = static_cast<std::size_t>(std::floor(g));
+        high[i] = std::min(static_cast<std::size_t>(std::ceil(g)), src - 1);
+        weight[i] = static_cast<float>(g - static_cast<double>(low[i]));
+      }
+    }
+  };
+  std::size_t width_{0};
+  std::size_t height_{0};
+  std::size_t dim_{0};
+  Axis x_;
+  Axis y_;
+  // due righe sorgente gia' interpolate in orizzontale (somme r + g + b)
+  std::vector<float> rows_[2];
+  std::size_t rowIndex_[2];
+
+  static float luminanceSum(const std::uint8_t* pixel) {
+    return static_cast<float>(pixel[0] + pixel[1] + pixel[2]);
+  }
+  // slot con la riga r interpolata; lo slot keep non viene sovrascritto
+  std::size_t row(const std::uint8_t* pixels, std::size_t r,
+                  std::size_t keep) {
+    for (std::size_t s = 0; s < 2; ++s) {
+      if (rowIndex_[s] == r) {
+        return s;
+      }
+    }
+    // le righe arrivano in ordine crescente: si sostituisce la piu' vecchia
+    std::size_t slot{rowIndex_[0] < rowIndex_[1] ? 0u : 1u};
+    if (slot == keep) {
+      slot = 1 - slot;
+    }
+    const std::uint8_t* source = pixels + r * width_ * 4;
+    float* out = rows_[slot].data();
+    for (std::size_t x = 0; x < dim_; ++x) {
+      const float w{x_.weight[x]};
+      out[x] = luminanceSum(source + x_.low[x] * 4) * (1.0f - w) +
+               luminanceSum(source + x_.high[x] * 4) * w;
+    }
+    rowIndex_[slot] = r;
+    return slot;
+  }
+
+ public:
+  // store(i, spin) riceve i pixel del pattern dim x dim in ordine: un
+  // std::vector<int> o una BitPattern gia' allocati
+  template <class Store>
+  void resize(const std::uint8_t* pixels, std::size_t width,
+              std::size_t height, std::size_t dim, Store store) {
+    if (width != width_ || height != height_ || dim != dim_) {
+      width_ = width;
+      height_ = height;
+      dim_ = dim;
+      x_.build(width, dim);
+      y_.build(height, dim);
+      rows_[0].resize(dim);
+      rows_[1].resize(dim);
+    }
+    // le righe in cache erano di un'altra immagine
+    rowIndex_[0] = rowIndex_[1] = static_cast<std::size_t>(-1);
+    for (std::size_t y = 0; y < dim; ++y) {
+      const std::size_t top{row(pixels, y_.low[y], 2)};
+      const std::size_t bottom{row(pixels, y_.high[y], top)};
+      const float* a = rows_[top].data();
+      const float* b = rows_[bottom].data();
+      const float w{y_.weight[y]};
+      // loop contiguo su dim pixel: interpolazione verticale e soglia
+      for (std::size_t x = 0; x < dim; ++x) {
+        const float sum{a[x] * (1.0f - w) + b[x] * w};
+        store(y * dim + x, sum < static_cast<float>(kDarkSum) ? 1 : -1);
+      }
+    }
+  }
+};
+
+// dal pattern ai pixel RGBA: spin +1 nero, -1 bianco, alfa opaco
+inline constexpr std::array<std::uint8_t, 4> kBlackPixel{0, 0, 0, 255};
+inline constexpr std::array<std::uint8_t, 4> kWhitePixel{255, 255, 255, 255};
+
+// un pixel come parola da 32 bit, con i byte nell'ordine di memoria
+inline std::uint32_t pixelWord(const std::array<std::uint8_t, 4>& pixel) {
+  std::uint32_t word;
+  std::memcpy(&word, pixel.data(), 4);
+  return word;
+}
+
+// rgba deve avere 4 byte per spin. Un confronto e una scelta fra due parole
+// per pixel: il compilatore lo vettorizza
+inline void renderPattern(std::span<const int> pattern,
+                          std::span<std::uint8_t> rgba) {
+  const std::uint32_t black{pixelWord(kBlackPixel)};
+  const std::uint32_t white{pixelWord(kWhitePixel)};
+  std::uint8_t* out = rgba.data();
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    const std::uint32_t word{pattern[i] == 1 ? black : white};
+    std::memcpy(out + i * 4, &word, 4);
+  }
+}
+
+// pattern impacchettato: ogni gruppo di 4 bit diventa 16 byte copiati da una
+// tabella di 16 voci
+inline void renderPattern(const BitPattern& pattern,
+                          std::span<std::uint8_t> rgba) {
+  static const auto table = [] {
+    std::array<std::array<std::uint8_t, 16>, 16> t{};
+    for (std::size_t nibble = 0; nibble < 16; ++nibble) {
+      for (std::size_t b = 0; b < 4; ++b) {
+        const auto& pixel = (nibble >> b) & 1u ? kBlackPixel : kWhitePixel;
+        std::copy(pixel.begin(), pixel.end(), t[nibble].begin() + b * 4);
+      }
+    }
+    return t;
+  }();
+  const std::span<const std::uint64_t> words{pattern.words()};
+  const std::size_t n{pattern.size()};
+  std::uint8_t* out = rgba.data();
+  std::size_t i{0};
+  for (; i + 4 <= n; i += 4) {
+    const auto nibble =
+        static_cast<std::size_t>((words[i / 64] >> (i % 64)) & 0xfu);
+    std::memcpy(out + i * 4, table[nibble].data(), 16);
+  }
+  for (; i < n; ++i) {
+    const auto& pixel = bitSpin(words, i) == 1 ? kBlackPixel : kWhitePixel;
+    std::memcpy(out + i * 4, pixel.data(), 4);
+  }
+}
+
+}  // namespace abc
+
+#endif
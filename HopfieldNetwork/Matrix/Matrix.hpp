@@ -1,55 +1,140 @@
 #ifndef HOPFIELDNEURALNETWORK_MATRIX_H
 #define HOPFIELDNEURALNETWORK_MATRIX_H
 
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
 #include <fstream>
+#include <span>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "MatrixStorage.hpp"
+
 namespace abc {
+
+// vista in sola lettura su una riga, confrontabile con std::vector
+template <class T>
+class MatrixRow : public std::span<const T> {
+ public:
+  using std::span<const T>::span;
+  MatrixRow(std::span<const T> row) : std::span<const T>(row) {}
+
+  friend bool operator==(MatrixRow a, const std::vector<T>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end());
+  }
+  friend bool operator==(MatrixRow a, MatrixRow b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end());
+  }
+};
+
+// vista sulle righe, mantiene l'interfaccia di getMatrix() (m[i][j], size(),
+// range-for sulle righe)
+template <class T>
+class MatrixRows {
+ private:
+  const T* data_;
+  std::size_t rows_;
+  std::size_t cols_;
+
+ public:
+  class iterator {
+   private:
+    const T* ptr_;
+    std::size_t cols_;
+
+   public:
+    using value_type = MatrixRow<T>;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() : ptr_{nullptr}, cols_{0} {}
+    iterator(const T* ptr, std::size_t cols) : ptr_{ptr}, cols_{cols} {}
+    MatrixRow<T> operator*() const { return MatrixRow<T>(ptr_, cols_); }
+    iterator& operator++() {
+      ptr_ += cols_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator old{*this};
+      ptr_ += cols_;
+      return old;
+    }
+    bool operator==(const iterator& other) const = default;
+  };
+
+  MatrixRows(const T* data, std::size_t rows, std::size_t cols)
+      : data_{data}, rows_{rows}, cols_{cols} {}
+
+  MatrixRow<T> operator[](std::size_t i) const {
+    return MatrixRow<T>(data_ + i * cols_, cols_);
+  }
+  std::size_t size() const { return rows_; }
+  bool empty() const { return rows_ == 0; }
+  iterator begin() const { return iterator(data_, cols_); }
+  iterator end() const { return iterator(data_ + rows_ * cols_, cols_); }
+};
+
 template <class T>
 class Matrix {
  private:
-  std::vector<std::vector<T>> matrix_;
+  // storage row-major contiguo: l'elemento (i, j) sta in data()[i * cols_ + j]
+  MatrixStorage<T> storage_;
+  std::size_t rows_{0};
+  std::size_t cols_{0};
   bool fixedSize_{false};
 
   void checkEmptiness() const  // class invariant
   {
-    if (matrix_.size() == 0) {
+    if (rows_ == 0) {
       throw std::runtime_error("Matrix is empty!");
     }
   }
+  void pushRow(const std::vector<T>& row) {
+    if (rows_ == 0) {
+      cols_ = row.size();
+    }
+    storage_.resize((rows_ + 1) * cols_);
+    std::copy(row.begin(), row.end(), storage_.data() + rows_ * cols_);
+    ++rows_;
+  }
+  // usato dal caricamento binario: verifica le dimensioni lette dall'header
+  auto denseElementCount() const {
+    return [this](const MatrixFileHeader& header) {
+      if (fixedSize_ && (header.rows != rows_ || header.cols != cols_)) {
+        throw std::runtime_error(
+            "Cannot load the file: matrix has a fixed size!");
+      }
+      return checkedProduct(header.rows, header.cols);
+    };
+  }
 
  public:
   Matrix() {}
-  Matrix(std::size_t rows, std::size_t cols, T default_val) {
-    std::vector<T> values(cols, default_val);
-    for (unsigned int row = 0; row < rows; ++row) {
-      matrix_.push_back(values);
-    }
-  }
+  Matrix(std::size_t rows, std::size_t cols, T default_val)
+      : storage_(rows * cols, default_val), rows_{rows}, cols_{cols} {}
 
   // setter
   void setElement(std::size_t i, std::size_t j, T value) {
     checkEmptiness();
-    if (i >= matrix_.size() || j >= matrix_[0].size()) {
+    if (i >= rows_ || j >= cols_) {
       throw std::runtime_error(
           "Point is not inside the matrix, please provide valid coordinates!");
     }
-    matrix_[i][j] = value;
+    (*this)(i, j) = value;
   }
   void setRow(const std::vector<T> newRow, std::size_t index) {
     checkEmptiness();
-    if (index >= matrix_.size()) {
+    if (index >= rows_) {
       throw std::runtime_error("Index is out of bounds!");
     }
-    if (newRow.size() > matrix_[index].size()) {
+    if (newRow.size() > cols_) {
       throw std::runtime_error(
           "New line is too long, please check its size and retry");
     }
 
-    std::copy(newRow.begin(), newRow.end(), matrix_[index].begin());
+    std::copy(newRow.begin(), newRow.end(), storage_.data() + index * cols_);
   }
   void setFixedSize(bool a) {
     checkEmptiness();
@@ -57,25 +142,45 @@ class Matrix {
   }
 
   // getter
-  const auto& getMatrix() const { return matrix_; }
+  MatrixRows<T> getMatrix() const {
+    return MatrixRows<T>(storage_.data(), rows_, cols_);
+  }
   auto getElement(std::size_t i, std::size_t j) const {
-    if (i >= matrix_.size() || j >= matrix_[0].size()) {
+    if (i >= rows_ || j >= cols_) {
       throw std::runtime_error("Indices are overcoming matrix dimension");
     }
-    return matrix_[i][j];
+    return (*this)(i, j);
   }
-  std::size_t size() const { return matrix_.size(); }
+  std::size_t size() const { return rows_; }
+  std::size_t cols() const { return cols_; }
+
+  // accesso senza controlli per i loop interni
+  T& operator()(std::size_t i, std::size_t j) {
+    return storage_.data()[i * cols_ + j];
+  }
+  const T& operator()(std::size_t i, std::size_t j) const {
+    return storage_.data()[i * cols_ + j];
+  }
+  std::span<T> row(std::size_t i) {
+    return std::span<T>(storage_.data() + i * cols_, cols_);
+  }
+  std::span<const T> row(std::size_t i) const {
+    return std::span<const T>(storage_.data() + i * cols_, cols_);
+  }
+  T* data() { return storage_.data(); }
+  const T* data() const { return storage_.data(); }
+  bool isMapped() const { return storage_.isMapped(); }
 
   // other methods
   void append(const std::vector<T>& pattern) {
     if (pattern.empty()) {
       throw std::runtime_error("Your vector is empty!");
     }
-    if (matrix_.empty()) {
-      matrix_.push_back(pattern);
-    } else if (pattern.size() == matrix_[0].size()) {
+    if (rows_ == 0) {
+      pushRow(pattern);
+    } else if (pattern.size() == cols_) {
       if (!fixedSize_) {
-        matrix_.push_back(pattern);
+        pushRow(pattern);
       } else {
         throw std::runtime_error(
             "Cannot append new rows: matrix has a fixed size!");
@@ -90,9 +195,9 @@ class Matrix {
     if (!file.is_open()) {
       throw std::runtime_error("Cannot create the file!");
     }
-    for (unsigned int i = 0; i < matrix_.size(); ++i) {
-      for (unsigned int j = 0; j < matrix_[0].size(); ++j) {
-        file << matrix_[i][j] << " ";
+    for (std::size_t i = 0; i < rows_; ++i) {
+      for (const T& value : row(i)) {
+        file << value << " ";
       }
       file << "\n";
     }
@@ -117,13 +222,16 @@ class Matrix {
         row.push_back(num);
       }
       if (!row.empty()) {
-        if (i >= matrix_.size()) {
-          if (!fixedSize_) {
-            matrix_.push_back(row);
-          } else {
+        if (i >= rows_) {
+          if (fixedSize_) {
             throw std::runtime_error(
                 "Cannot append new rows: matrix has a fixed size!");
           }
+          if (rows_ != 0 && row.size() > cols_) {
+            throw std::runtime_error(
+                "New line is too long, please check its size and retry");
+          }
+          pushRow(row);  // le righe piu' corte sono completate con T{}
         } else {
           setRow(row, i);
         }
@@ -133,12 +241,62 @@ class Matrix {
     file.close();
   }
 
+  bool saveOnBinaryFile(const std::string& filepath) const {
+    checkEmptiness();
+    storage_.save(filepath, MatrixLayout::Dense, rows_, cols_);
+    return true;
+  }
+  void loadMatrixFromBinaryFile(const std::string& filepath,
+                                bool verifyChecksum = true) {
+    const auto header{storage_.load(filepath, MatrixLayout::Dense,
+                                    verifyChecksum, denseElementCount())};
+    rows_ = header.rows;
+    cols_ = header.cols;
+  }
+  // carica senza copie dal file mappato; append() copia prima i dati in un
+  // buffer proprio. Il checksum si verifica sempre, salvo chiedere il
+  // contrario (file fidati e molto grandi)
+  void mapBinaryFile(const std::string& filepath,
+                     bool verifyChecksum = true) {
+    const auto header{storage_.map(filepath, MatrixLayout::Dense,
+                                   verifyChecksum, denseElementCount())};
+    rows_ = header.rows;
+    cols_ = header.cols;
+  }
+
   size_t NumberOfElement() const {
     checkEmptiness();
-    return matrix_.size() * matrix_[0].size();
+    return rows_ * cols_;
   }
 };
 
+// tiene solo le colonne con keep[q] di una matrice row-major con b colonne
+// (i pattern che escono da un recupero a blocchi). Ritorna le colonne rimaste
+template <class T, class Keep>
+std::size_t keepColumns(std::vector<T>& values, std::size_t b,
+                        const Keep& keep) {
+  std::size_t kept{0};
+  for (std::size_t q = 0; q < b; ++q) {
+    if (keep[q]) {
+      ++kept;
+    }
+  }
+  if (kept == b) {
+    return b;
+  }
+  const std::size_t rows{b == 0 ? 0 : values.size() / b};
+  std::size_t out{0};
+  for (std::size_t r = 0; r < rows; ++r) {
+    for (std::size_t q = 0; q < b; ++q) {
+      if (keep[q]) {
+        values[out++] = values[r * b + q];
+      }
+    }
+  }
+  values.resize(out);
+  return kept;
+}
+
 namespace fs = std::filesystem;
 
 // not tested
@@ -159,4 +317,4 @@ inline const std::vector<std::string> setDirectory(const std::string& input) {
 };
 }  // namespace abc
 
-#endif
\ No newline at end of file
+#endif
@@ -1,7 +1,25 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "Matrix.hpp"
+#include "Parallel.hpp"
+#include "Random.hpp"
+#include "BitPattern.hpp"
+#include "CoolingSchedule.hpp"
+#include "ImageKernels.hpp"
+#include "MemoryIndex.hpp"
+#include "PatternCache.hpp"
+#include "SimdKernels.hpp"
+#include "SymmetricMatrix.hpp"
+#include "TempFile.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
 #include <fstream>
+#include <random>
+#include <thread>
 
 #include "../doctest.h"
 
@@ -31,7 +49,8 @@ TEST_CASE("Matrix setElement") {
   }
 }
 TEST_CASE("Matrix saveOnFile") {
-  const std::string filepath = "test_output.txt";
+  const abc::TempFile output("test_output.txt");
+  const std::string filepath = output.path();
 
   abc::Matrix<int> m(2, 3, 0);
   m.setElement(0, 0, 1);
@@ -82,7 +101,8 @@ TEST_CASE("Matrix setRow") {
   }
 }
 TEST_CASE("Matrix loadMatrixFromFile") {
-  const std::string test_filepath = "matrix_input.txt";
+  const abc::TempFile input("matrix_input.txt");
+  const std::string test_filepath = input.path();
 
   std::ofstream out(test_filepath);
   SUBCASE(
@@ -244,4 +264,939 @@ TEST_CASE("Matrix nElment")
 {
   abc::Matrix m(2, 2, 0);
   CHECK(m.NumberOfElement() == 4);
-}
\ No newline at end of file
+}
+TEST_CASE("Matrix contiguous storage") {
+  abc::Matrix<double> m(3, 4, 0.0);
+  m.setElement(1, 2, 7.5);
+
+  SUBCASE("Rows are stored one after the other") {
+    CHECK(m.cols() == 4);
+    CHECK(m.data()[1 * 4 + 2] == 7.5);
+    CHECK(m.row(1).data() == m.data() + 4);
+    CHECK(reinterpret_cast<std::uintptr_t>(m.data()) % 64 == 0);
+  }
+  SUBCASE("Row view reads and writes the matrix") {
+    auto row = m.row(2);
+    CHECK(row.size() == 4);
+    row[3] = -1.0;
+    CHECK(m.getElement(2, 3) == -1.0);
+    CHECK(m(1, 2) == 7.5);
+  }
+  SUBCASE("Appending keeps the layout contiguous") {
+    abc::Matrix<int> a;
+    a.append({1, 2});
+    a.append({3, 4});
+    CHECK(a.data()[3] == 4);
+    CHECK(a.getMatrix()[1] == std::vector<int>{3, 4});
+  }
+}
+TEST_CASE("Matrix binary file") {
+  const abc::TempFile binary("matrix_binary.bin");
+  const abc::TempFile text("test_output.txt");
+  const std::string filepath = binary.path();
+
+  abc::Matrix<double> m(3, 2, 0.0);
+  m.setElement(0, 1, 0.25);
+  m.setElement(2, 0, -1.5);
+  m.saveOnBinaryFile(filepath);
+
+  SUBCASE("Matrix binary file - header is recognized") {
+    CHECK(abc::isBinaryMatrixFile(filepath));
+    m.saveOnFile(text.path());
+    CHECK_FALSE(abc::isBinaryMatrixFile(text.path()));
+  }
+  SUBCASE("Matrix binary file - copying load") {
+    abc::Matrix<double> loaded;
+    loaded.loadMatrixFromBinaryFile(filepath);
+    CHECK_FALSE(loaded.isMapped());
+    CHECK(loaded.size() == 3);
+    CHECK(loaded.cols() == 2);
+    CHECK(loaded.getElement(0, 1) == 0.25);
+    CHECK(loaded.getElement(2, 0) == -1.5);
+  }
+  SUBCASE("Matrix binary file - mapped load") {
+    abc::Matrix<double> mapped;
+    mapped.mapBinaryFile(filepath, true);
+    CHECK(mapped.isMapped());
+    CHECK(mapped.getElement(0, 1) == 0.25);
+    CHECK(mapped.getElement(2, 0) == -1.5);
+
+    mapped.setElement(1, 1, 9.0);  // private to the process
+    abc::Matrix<double> fromDisk;
+    fromDisk.loadMatrixFromBinaryFile(filepath);
+    CHECK(fromDisk.getElement(1, 1) == 0.0);
+
+    abc::Matrix<double> copy(mapped);
+    CHECK_FALSE(copy.isMapped());
+    CHECK(copy.getElement(1, 1) == 9.0);
+
+    mapped.append({4.0, 5.0});
+    CHECK_FALSE(mapped.isMapped());
+    CHECK(mapped.size() == 4);
+    CHECK(mapped.getElement(0, 1) == 0.25);
+    CHECK(mapped.getElement(3, 1) == 5.0);
+  }
+  SUBCASE("Matrix binary file - wrong element type") {
+    abc::Matrix<int> wrongType;
+    CHECK_THROWS_WITH_AS(wrongType.mapBinaryFile(filepath),
+                         "Binary file element type does not match!",
+                         std::runtime_error);
+  }
+  SUBCASE("Matrix binary file - fixed size mismatch") {
+    abc::Matrix<double> fixed(2, 2, 0.0);
+    fixed.setFixedSize(true);
+    CHECK_THROWS_WITH_AS(fixed.loadMatrixFromBinaryFile(filepath),
+                         "Cannot load the file: matrix has a fixed size!",
+                         std::runtime_error);
+  }
+  SUBCASE("Matrix binary file - corrupted payload") {
+    {
+      std::fstream file(filepath,
+                        std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(sizeof(abc::MatrixFileHeader) + 3);
+      file.put('\x7f');
+    }
+    abc::Matrix<double> loaded;
+    CHECK_THROWS_WITH_AS(loaded.loadMatrixFromBinaryFile(filepath),
+                         "Binary matrix file checksum mismatch!",
+                         std::runtime_error);
+  }
+  SUBCASE("Matrix binary file - sizes in the header are checked") {
+    abc::MatrixFileHeader header;
+    {
+      std::ifstream file(filepath, std::ios::binary);
+      file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    }
+    auto rewrite = [&](std::uint64_t rows, std::uint64_t cols) {
+      header.rows = rows;
+      header.cols = cols;
+      std::fstream file(filepath,
+                        std::ios::in | std::ios::out | std::ios::binary);
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    };
+    abc::Matrix<double> loaded;
+    rewrite(std::uint64_t{1} << 40, std::uint64_t{1} << 40);  // trabocca
+    CHECK_THROWS_WITH_AS(loaded.loadMatrixFromBinaryFile(filepath),
+                         "Binary matrix file header is corrupted!",
+                         std::runtime_error);
+    CHECK_THROWS_WITH_AS(loaded.mapBinaryFile(filepath),
+                         "Binary matrix file header is corrupted!",
+                         std::runtime_error);
+    rewrite(std::uint64_t{1} << 36, 2);  // 1 TB: piu' lungo del file
+    CHECK_THROWS_WITH_AS(loaded.loadMatrixFromBinaryFile(filepath),
+                         "Binary matrix file is truncated!",
+                         std::runtime_error);
+    CHECK_THROWS_WITH_AS(loaded.mapBinaryFile(filepath),
+                         "Binary matrix file is truncated!",
+                         std::runtime_error);
+    abc::SymmetricMatrix<double> symmetric;
+    header.layout =
+        static_cast<std::uint32_t>(abc::MatrixLayout::SymmetricPacked);
+    rewrite(std::uint64_t{1} << 40, std::uint64_t{1} << 40);
+    CHECK_THROWS_WITH_AS(symmetric.mapBinaryFile(filepath),
+                         "Binary matrix file header is corrupted!",
+                         std::runtime_error);
+  }
+  SUBCASE("Matrix binary file - mapping verifies the checksum") {
+    {
+      std::fstream file(filepath,
+                        std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(sizeof(abc::MatrixFileHeader) + 3);
+      file.put('\x7f');
+    }
+    abc::Matrix<double> mapped;
+    CHECK_THROWS_WITH_AS(mapped.mapBinaryFile(filepath),
+                         "Binary matrix file checksum mismatch!",
+                         std::runtime_error);
+    CHECK_NOTHROW(mapped.mapBinaryFile(filepath, false));  // su richiesta
+  }
+  SUBCASE("Matrix binary file - text file is rejected") {
+    m.saveOnFile(text.path());
+    abc::Matrix<double> loaded;
+    CHECK_THROWS_WITH_AS(loaded.loadMatrixFromBinaryFile(text.path()),
+                         "Not a valid binary matrix file!",
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("SymmetricMatrix") {
+  abc::SymmetricMatrix<double> m(4);
+  m.setElement(0, 1, 1.0);
+  m.setElement(2, 0, -2.0);
+  m.setElement(1, 3, 0.5);
+  m.setElement(2, 3, 3.0);
+  // dense equivalent
+  const std::vector<std::vector<double>> dense{{0.0, 1.0, -2.0, 0.0},
+                                               {1.0, 0.0, 0.0, 0.5},
+                                               {-2.0, 0.0, 0.0, 3.0},
+                                               {0.0, 0.5, 3.0, 0.0}};
+  const std::vector<int> state{1, -1, -1, 1};
+
+  SUBCASE("SymmetricMatrix - stores only the strict upper triangle") {
+    CHECK(m.size() == 4);
+    CHECK(m.packedSize() == 6);
+    CHECK(m.upperRow(0).size() == 3);
+    CHECK(m.upperRow(3).empty());
+    for (std::size_t i = 0; i < 4; ++i) {
+      for (std::size_t j = 0; j < 4; ++j) {
+        CHECK(m.getElement(i, j) == dense[i][j]);
+      }
+    }
+  }
+  SUBCASE("SymmetricMatrix - diagonal and bounds") {
+    CHECK_NOTHROW(m.setElement(1, 1, 0.0));
+    CHECK_THROWS_WITH_AS(
+        m.setElement(1, 1, 2.0),
+        "The diagonal of a symmetric packed matrix is always zero!",
+        std::runtime_error);
+    CHECK_THROWS_WITH_AS(m.getElement(4, 0),
+                         "Indices are overcoming matrix dimension",
+                         std::runtime_error);
+  }
+  SUBCASE("SymmetricMatrix - kernels match the dense product") {
+    std::vector<double> field(4);
+    m.multiply(state, field);
+    double quadratic{0.0};
+    for (std::size_t i = 0; i < 4; ++i) {
+      double expected{0.0};
+      for (std::size_t j = 0; j < 4; ++j) {
+        expected += dense[i][j] * state[j];
+      }
+      CHECK(field[i] == doctest::Approx(expected));
+      CHECK(m.field(i, state) == doctest::Approx(expected));
+      quadratic += 0.5 * expected * state[i];
+    }
+    CHECK(m.quadraticForm(state) == doctest::Approx(quadratic));
+  }
+  SUBCASE("SymmetricMatrix - fused sign of the field") {
+    std::vector<double> field(4);
+    std::vector<int> sign(4);
+    m.multiplySign(state, field, sign);
+    for (std::size_t i = 0; i < 4; ++i) {
+      CHECK(field[i] == doctest::Approx(m.field(i, state)));
+      CHECK(sign[i] == (field[i] > 0.0 ? 1 : -1));
+    }
+    std::vector<double> tail(4, 1.0);
+    m.addRowAbove(1, -2.0, tail);
+    CHECK(tail == std::vector<double>{1.0, 1.0, 1.0, 0.0});
+  }
+  SUBCASE("SymmetricMatrix - binary and text files") {
+    const abc::TempFile binary("symmetric_binary.bin");
+    const abc::TempFile text("test_output.txt");
+    m.saveOnBinaryFile(binary.path());
+    abc::SymmetricMatrix<double> mapped;
+    mapped.mapBinaryFile(binary.path(), true);
+    CHECK(mapped.isMapped());
+    CHECK(mapped.getElement(3, 2) == 3.0);
+
+    abc::Matrix<double> dense_m;
+    CHECK_THROWS_WITH_AS(dense_m.mapBinaryFile(binary.path()),
+                         "Binary file layout does not match!",
+                         std::runtime_error);
+
+    m.saveOnFile(text.path());
+    abc::SymmetricMatrix<double> fromText;
+    fromText.loadMatrixFromFile(text.path());
+    CHECK(fromText.size() == 4);
+    CHECK(fromText.getElement(0, 2) == -2.0);
+    CHECK(fromText.getElement(3, 1) == 0.5);
+  }
+  SUBCASE("SymmetricMatrix - text files must be square") {
+    const abc::TempFile shortRows("symmetric_short.txt");
+    const abc::TempFile extraRows("symmetric_rows.txt");
+    const abc::TempFile text("test_output.txt");
+    {
+      std::ofstream file(shortRows.path());
+      file << "0 1 2\n1 0\n2 3 0\n";
+    }
+    abc::SymmetricMatrix<double> loaded;
+    CHECK_THROWS_WITH_AS(
+        loaded.loadMatrixFromFile(shortRows.path()),
+        "New line is too short, please check its size and retry",
+        std::runtime_error);
+    {
+      std::ofstream file(extraRows.path());
+      file << "0 1\n1 0\n2 3\n";
+    }
+    CHECK_THROWS_WITH_AS(loaded.loadMatrixFromFile(extraRows.path()),
+                         "Matrix dimensions do not match!",
+                         std::runtime_error);
+    m.setFixedSize(true);
+    CHECK_THROWS_WITH_AS(m.loadMatrixFromFile(extraRows.path()),
+                         "New line is too short, please check its size and "
+                         "retry",
+                         std::runtime_error);
+    m.saveOnFile(text.path());
+    CHECK_NOTHROW(m.loadMatrixFromFile(text.path()));
+    CHECK(m.getElement(2, 3) == 3.0);
+  }
+}
+
+TEST_CASE("ThreadPool") {
+  abc::ThreadPool pool(4);
+  CHECK(pool.size() == 4);
+
+  SUBCASE("ThreadPool - every index runs once, on a valid worker") {
+    for (int run = 0; run < 3; ++run) {
+      std::vector<std::atomic<int>> hits(1000);
+      std::atomic<bool> badWorker{false};
+      pool.run(hits.size(), [&](std::size_t i, unsigned int worker) {
+        hits[i].fetch_add(1);
+        if (worker >= pool.size()) badWorker = true;
+      });
+      CHECK_FALSE(badWorker.load());
+      CHECK(std::all_of(hits.begin(), hits.end(),
+                        [](const auto& h) { return h.load() == 1; }));
+    }
+  }
+  SUBCASE("ThreadPool - parallel fused product matches the serial one") {
+    const std::size_t n{301};
+    abc::SymmetricMatrix<double> m(n);
+    std::vector<int> state(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      state[i] = (i * 7 % 5 < 2) ? 1 : -1;
+      for (std::size_t j = i + 1; j < n; ++j) {
+        m(i, j) = static_cast<double>((i * 31 + j * 17) % 11) - 5.5;
+      }
+    }
+    std::vector<double> field(n);
+    std::vector<double> parallelField(n);
+    std::vector<int> sign(n);
+    std::vector<int> parallelSign(n);
+    m.multiplySign(state, field, sign);
+    m.multiplySign(state, parallelField, parallelSign, pool);
+    for (std::size_t i = 0; i < n; ++i) {
+      CHECK(parallelField[i] == doctest::Approx(field[i]));
+    }
+    CHECK(parallelSign == sign);
+
+    // con un workspace i buffer per thread si allocano una volta sola
+    abc::SymmetricMatrix<double>::SignWorkspace work;
+    m.multiplySign(state, parallelField, parallelSign, pool, work);
+    REQUIRE(work.partial.size() == pool.size());
+    const double* buffer{work.partial.back().data()};
+    for (auto& s : state) {
+      s = -s;
+    }
+    m.multiplySign(state, field, sign);
+    m.multiplySign(state, parallelField, parallelSign, pool, work);
+    CHECK(work.partial.back().data() == buffer);
+    for (std::size_t i = 0; i < n; ++i) {
+      CHECK(parallelField[i] == doctest::Approx(field[i]));
+    }
+    CHECK(parallelSign == sign);
+  }
+}
+TEST_CASE("SymmetricMatrix - batch product with a pool") {
+  const std::size_t n{97};
+  const std::size_t b{7};
+  abc::SymmetricMatrix<double> m(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t j = i + 1; j < n; ++j) {
+      m(i, j) = static_cast<double>((i * 13 + j * 5) % 9) - 4.0;
+    }
+  }
+  std::vector<std::int8_t> states(n * b);
+  for (std::size_t k = 0; k < n * b; ++k) {
+    states[k] = (k * 11 % 7 < 3) ? 1 : -1;
+  }
+  std::vector<double> fields(n * b);
+  std::vector<double> parallelFields(n * b);
+  abc::ThreadPool pool(3);
+  m.multiplyBatch(states, b, fields);
+  m.multiplyBatch(states, b, parallelFields, pool);
+  CHECK(parallelFields == fields);
+
+  // ogni colonna e' il prodotto W * s del suo stato
+  std::vector<int> state(n);
+  std::vector<double> field(n);
+  for (std::size_t q = 0; q < b; ++q) {
+    for (std::size_t i = 0; i < n; ++i) {
+      state[i] = states[i * b + q];
+    }
+    m.multiply(state, field);
+    for (std::size_t i = 0; i < n; ++i) {
+      CHECK(fields[i * b + q] == doctest::Approx(field[i]));
+    }
+  }
+}
+TEST_CASE("BoundedQueue") {
+  abc::BoundedQueue<int> queue(2);
+  std::vector<int> received;
+  std::thread consumer([&]() {
+    while (auto item = queue.pop()) {
+      received.push_back(*item);
+    }
+  });
+  // con capacita' 2 il produttore aspetta il consumatore
+  for (int i = 0; i < 100; ++i) {
+    CHECK(queue.push(i));
+  }
+  queue.close();
+  consumer.join();
+  CHECK(received.size() == 100);
+  CHECK(std::is_sorted(received.begin(), received.end()));
+  CHECK_FALSE(queue.push(100));
+  CHECK_FALSE(queue.pop().has_value());
+}
+
+TEST_CASE("SIMD kernels") {
+  // lunghezze che non sono multipli della larghezza dei registri, per
+  // passare anche dalle code scalari
+  const std::size_t n{37};
+  std::vector<double> w(n);
+  std::vector<int> s(n);
+  for (std::size_t k = 0; k < n; ++k) {
+    w[k] = 0.25 * static_cast<double>(k % 7) - 0.5;
+    s[k] = (k * 5 % 3 == 0) ? 1 : -1;
+  }
+  const auto& scalar = abc::simd::kernels(abc::simd::Isa::Scalar);
+  const double expectedDot{scalar.dot(w.data(), s.data(), n)};
+  std::vector<double> expectedY(n, 1.0);
+  scalar.axpy(expectedY.data(), w.data(), -2.0, n);
+
+  CHECK(abc::simd::isSupported(abc::simd::Isa::Scalar));
+  CHECK(abc::simd::isSupported(abc::simd::activeIsa()));
+  for (auto isa : {abc::simd::Isa::SSE2, abc::simd::Isa::AVX2,
+                   abc::simd::Isa::AVX512}) {
+    if (!abc::simd::isSupported(isa)) {
+      continue;
+    }
+    CAPTURE(abc::simd::isaName(isa));
+    const auto& k = abc::simd::kernels(isa);
+    for (std::size_t len : {std::size_t{0}, std::size_t{3}, n}) {
+      CHECK(k.dot(w.data(), s.data(), len) ==
+            doctest::Approx(scalar.dot(w.data(), s.data(), len)));
+    }
+    std::vector<double> y(n, 1.0);
+    k.axpy(y.data(), w.data(), -2.0, n);
+    for (std::size_t j = 0; j < n; ++j) {
+      CHECK(y[j] == doctest::Approx(expectedY[j]));
+    }
+    std::vector<double> y2(n, 1.0);
+    CHECK(k.dotAxpy(w.data(), s.data(), y2.data(), -2.0, n) ==
+          doctest::Approx(expectedDot));
+    for (std::size_t j = 0; j < n; ++j) {
+      CHECK(y2[j] == doctest::Approx(expectedY[j]));
+    }
+  }
+  SUBCASE("SIMD kernels - float exp") {
+    for (float x : {-80.0f, -10.0f, -1.0f, 0.0f, 0.5f, 3.0f, 40.0f}) {
+      CHECK(abc::simd::fastExp(x) ==
+            doctest::Approx(std::exp(x)).epsilon(1e-6));
+    }
+    CHECK(abc::simd::fastExp(-1000.0f) < 1e-37f);
+    std::vector<float> x(37);
+    double expected{0.0};
+    for (std::size_t k = 0; k < x.size(); ++k) {
+      x[k] = 0.3f * static_cast<float>(k) - 6.0f;
+      expected += std::exp(static_cast<double>(x[k]));
+    }
+    for (auto isa : {abc::simd::Isa::Scalar, abc::simd::Isa::SSE2,
+                     abc::simd::Isa::AVX2, abc::simd::Isa::AVX512}) {
+      if (abc::simd::isSupported(isa)) {
+        CAPTURE(abc::simd::isaName(isa));
+        CHECK(abc::simd::kernels(isa).expSum(x.data(), x.size()) ==
+              doctest::Approx(expected).epsilon(1e-5));
+      }
+    }
+  }
+  CHECK_FALSE(abc::simd::setActiveIsa(static_cast<abc::simd::Isa>(99)));
+}
+
+TEST_CASE("Random") {
+  SUBCASE("Random - same seed, same sequence") {
+    abc::Xoshiro256 a(123);
+    abc::Xoshiro256 b(123);
+    abc::Xoshiro256 c(124);
+    bool differs{false};
+    for (int i = 0; i < 100; ++i) {
+      const auto x = a();
+      CHECK(x == b());
+      differs |= x != c();
+    }
+    CHECK(differs);
+  }
+  SUBCASE("Random - jump gives a different stream") {
+    abc::Xoshiro256 a(5);
+    abc::Xoshiro256 b(a);
+    b.jump();
+    CHECK(a() != b());
+
+    // le lane del generatore vettoriale sono lo scalare dopo 0, 1, 2, 3 salti
+    std::vector<double> block(8);
+    abc::Xoshiro256x4(5).fillUniform(block);
+    abc::Xoshiro256 lane(5);
+    for (std::size_t k = 0; k < 4; ++k) {
+      abc::Xoshiro256 copy{lane};
+      CHECK(block[k] == copy.uniform());
+      CHECK(block[k + 4] == copy.uniform());
+      lane.jump();
+    }
+  }
+  SUBCASE("Random - uniform blocks are in [0, 1) and reproducible") {
+    abc::UniformStream stream(7, 64);
+    abc::UniformStream same(7, 64);
+    double sum{0.0};
+    const int count{10000};
+    for (int i = 0; i < count; ++i) {
+      const double u = stream();
+      CHECK(u == same());
+      CHECK(u >= 0.0);
+      CHECK(u < 1.0);
+      sum += u;
+    }
+    CHECK(sum / count == doctest::Approx(0.5).epsilon(0.02));
+
+    std::vector<double> block(10);
+    abc::Xoshiro256x4(7).fillUniform(block);
+    stream.seed(7);
+    for (double u : block) {
+      CHECK(u == stream());
+    }
+  }
+  SUBCASE("Random - thread streams are seeded from a common seed") {
+    CHECK(abc::streamSeed(1, 0) != abc::streamSeed(1, 1));
+    CHECK(abc::streamSeed(1, 2) == abc::streamSeed(1, 2));
+    abc::setThreadSeed(42);
+    double first{0.0};
+    double second{0.0};
+    std::thread([&]() { first = abc::threadUniformStream()(); }).join();
+    std::thread([&]() { second = abc::threadUniformStream()(); }).join();
+    CHECK(first == abc::UniformStream(abc::streamSeed(42, 0))());
+    CHECK(second == abc::UniformStream(abc::streamSeed(42, 1))());
+  }
+  SUBCASE("Random - distinct indices in O(k)") {
+    abc::DistinctSampler sampler;
+    abc::Xoshiro256 generator(3);
+    std::vector<int> hits(50, 0);
+    for (int run = 0; run < 200; ++run) {
+      std::vector<std::size_t> picked;
+      sampler.sample(50, 10, generator,
+                     [&](std::size_t i) { picked.push_back(i); });
+      std::sort(picked.begin(), picked.end());
+      CHECK(std::adjacent_find(picked.begin(), picked.end()) == picked.end());
+      CHECK(picked.back() < 50);
+      for (std::size_t i : picked) {
+        ++hits[i];
+      }
+    }
+    // 2000 estrazioni su 50 indici: tutti escono, nessuno troppo spesso
+    CHECK(*std::min_element(hits.begin(), hits.end()) > 10);
+    CHECK(*std::max_element(hits.begin(), hits.end()) < 80);
+
+    // stesso seme, stessi indici, anche con un sampler gia' usato
+    std::vector<std::size_t> a;
+    std::vector<std::size_t> b;
+    abc::Xoshiro256 first(9);
+    abc::Xoshiro256 second(9);
+    sampler.sample(20, 20, first, [&](std::size_t i) { a.push_back(i); });
+    abc::DistinctSampler fresh;
+    fresh.sample(20, 20, second, [&](std::size_t i) { b.push_back(i); });
+    CHECK(a == b);
+    CHECK_THROWS_WITH_AS(
+        sampler.sample(3, 4, first, [](std::size_t) {}),
+        "Cannot sample more indices than available.", std::runtime_error);
+  }
+}
+
+TEST_CASE("Cooling") {
+  SUBCASE("Cooling - logarithmic schedule and its reciprocal") {
+    abc::Cooling cooling(50.0);
+    CHECK(cooling.at(0).value == 50.0);
+    CHECK(cooling.at(0).inverse == doctest::Approx(1.0 / 50.0));
+    CHECK(cooling.at(3).value ==
+          doctest::Approx(50.0 / std::log(5.0)).epsilon(1e-6));
+    CHECK(cooling.at(3).value * cooling.at(3).inverse == doctest::Approx(1.0));
+  }
+  SUBCASE("Cooling - geometric and linear schedules") {
+    abc::Cooling cooling(8.0, abc::GeometricCooling{0.5});
+    CHECK(cooling.at(2).value == 2.0);
+    cooling.setPolicy(abc::LinearCooling{3.0});
+    CHECK(cooling.at(2).value == 2.0);
+    CHECK(cooling.at(5).value == 0.0);
+    CHECK(std::isinf(cooling.at(5).inverse));
+    cooling.setT0(20.0);
+    CHECK(cooling.at(2).value == 14.0);
+  }
+  SUBCASE("Cooling - adaptive schedule follows the acceptance") {
+    abc::Cooling cooling(10.0, abc::AdaptiveCooling{0.5, 0.9, 0.1});
+    CHECK(cooling.at(0).value == 10.0);
+    cooling.observe(0.5);  // molte mosse accettate: raffredda piano
+    CHECK(cooling.at(1).value == doctest::Approx(9.0));
+    cooling.observe(0.0);
+    CHECK(cooling.at(2).value == doctest::Approx(4.5));
+    // la temperatura di base non tocca la corsa in corso
+    CHECK(cooling.base().value == 10.0);
+    CHECK(cooling.base().inverse == doctest::Approx(0.1));
+    // ne' at(0): una corsa riparte solo con reset()
+    CHECK(cooling.at(0).value == doctest::Approx(4.5));
+    cooling.observe(0.0);
+    CHECK(cooling.at(3).value == doctest::Approx(2.25));
+    cooling.reset();
+    CHECK(cooling.at(0).value == 10.0);
+  }
+}
+
+TEST_CASE("BitPattern") {
+  std::vector<int> a(130);
+  std::vector<int> b(130);
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    a[i] = (i % 3 == 0) ? 1 : -1;
+    b[i] = (i % 5 == 0 || i > 120) ? 1 : -1;
+  }
+  const abc::BitPattern pa(a);
+  const abc::BitPattern pb(b);
+
+  SUBCASE("BitPattern - packs and unpacks spins") {
+    CHECK(pa.size() == 130);
+    CHECK(pa.words().size() == 3);
+    CHECK(pa.toVector() == a);
+    CHECK(pa[0] == 1);
+    CHECK(pa[1] == -1);
+  }
+  SUBCASE("BitPattern - popcount dot product") {
+    int expected{0};
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      expected += a[i] * b[i];
+    }
+    CHECK(abc::dot(pa, pb) == expected);
+    CHECK(abc::dot(pa, pa) == 130);
+  }
+  SUBCASE("BitPattern - set and flip") {
+    abc::BitPattern p(pa);
+    p.flip(129);
+    CHECK(p[129] == -pa[129]);
+    p.set(129, pa[129]);
+    CHECK(p == pa);
+    CHECK(abc::BitPattern(3).toVector() == std::vector<int>{-1, -1, -1});
+  }
+  SUBCASE("BitColumns - transposed patterns") {
+    abc::BitColumns columns(pa.size());
+    std::vector<abc::BitPattern> patterns;
+    for (int p = 0; p < 130; ++p) {
+      std::vector<int> pattern(pa.size());
+      for (std::size_t i = 0; i < pattern.size(); ++i) {
+        pattern[i] = (i * 7 + static_cast<std::size_t>(p) * 13) % 5 < 2 ? 1
+                                                                       : -1;
+      }
+      patterns.emplace_back(pattern);
+      columns.append(patterns.back().words());
+    }
+    CHECK(columns.size() == 130);
+    bool same{true};
+    for (std::size_t i = 0; i < pa.size(); ++i) {
+      CHECK(columns.column(i).size() == 3);
+      for (std::size_t p = 0; p < patterns.size(); ++p) {
+        same = same && abc::bitSpin(columns.column(i), p) == patterns[p][i];
+      }
+    }
+    CHECK(same);
+    columns.clear();
+    CHECK(columns.size() == 0);
+    CHECK_THROWS_WITH_AS(columns.append(abc::BitPattern(10).words()),
+                         "Bit patterns sizes do not match!",
+                         std::runtime_error);
+  }
+  SUBCASE("BitPattern - size mismatch") {
+    CHECK_THROWS_WITH_AS(abc::dot(pa, abc::BitPattern(10)),
+                         "Bit patterns sizes do not match!",
+                         std::runtime_error);
+  }
+}
+TEST_CASE("MultiIndexHash") {
+  const std::size_t n{100};  // 7 sottostringhe, l'ultima da 4 bit
+  std::mt19937 gen(31);
+  std::uniform_int_distribution<int> coin(0, 1);
+  std::vector<abc::BitPattern> memories;
+  std::vector<std::uint64_t> rows;  // le righe restano del chiamante
+  for (int m = 0; m < 50; ++m) {
+    std::vector<int> pattern(n);
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    memories.emplace_back(pattern);
+    rows.insert(rows.end(), memories.back().words().begin(),
+                memories.back().words().end());
+  }
+  abc::MultiIndexHash index(n);
+  index.build(rows);
+  CHECK(index.size() == 50);
+  CHECK(index.chunks() == 7);
+  std::vector<std::size_t> found;
+
+  SUBCASE("MultiIndexHash - an intact chunk is enough") {
+    abc::BitPattern query = memories[17];
+    for (std::size_t i = 16; i < n; ++i) query.flip(i);
+    CHECK(index.candidates(rows, query.words(), 50, found) == 1);
+    CHECK(std::find(found.begin(), found.end(), 17) != found.end());
+    CHECK(std::is_sorted(found.begin(), found.end()));
+  }
+  SUBCASE("MultiIndexHash - one flip per chunk hides the memory") {
+    abc::BitPattern query = memories[17];
+    for (std::size_t i = 0; i < n; i += 16) query.flip(i);
+    // lo stesso workspace per tutte le ricerche, anche dopo build
+    abc::MultiIndexHash::SearchWorkspace work;
+    index.candidates(rows, query.words(), 50, found, work);
+    CHECK(std::find(found.begin(), found.end(), 17) == found.end());
+    // dopo build le memorie nuove sono nell'indice
+    rows.insert(rows.end(), query.words().begin(), query.words().end());
+    index.build(rows);
+    index.candidates(rows, query.words(), 1, found, work);
+    CHECK(found == std::vector<std::size_t>{50});
+    CHECK(work.matches.size() == 51);
+  }
+  SUBCASE("MultiIndexHash - size mismatch") {
+    CHECK_THROWS_WITH_AS(
+        index.candidates(rows, abc::BitPattern(200).words(), 1, found),
+        "Memory index: pattern size mismatch", std::runtime_error);
+    rows.pop_back();
+    CHECK_THROWS_WITH_AS(index.build(rows),
+                         "Memory index: pattern size mismatch",
+                         std::runtime_error);
+  }
+}
+TEST_CASE("MultiIndexHash - correlated memories") {
+  // 256 bit, 20 gruppi da 10 memorie: 4 sottostringhe di bordo comuni a
+  // tutte, 8 di sfondo comuni al gruppo, 4 proprie. Con una sola
+  // sottostringa uguale ogni memoria sarebbe candidata (il bordo)
+  const std::size_t n{256};
+  const std::size_t count{200};
+  std::mt19937 gen(4);
+  std::uniform_int_distribution<int> coin(0, 1);
+  auto randomSpins = [&](std::vector<int>& pattern, std::size_t from,
+                         std::size_t to) {
+    for (std::size_t i = from; i < to; ++i) pattern[i] = coin(gen) ? 1 : -1;
+  };
+  std::vector<int> group(n);
+  randomSpins(group, 0, 64);
+  std::vector<std::uint64_t> rows;
+  std::vector<abc::BitPattern> memories;
+  for (std::size_t m = 0; m < count; ++m) {
+    if (m % 10 == 0) {
+      randomSpins(group, 64, 192);
+    }
+    std::vector<int> pattern{group};
+    randomSpins(pattern, 192, n);
+    memories.emplace_back(pattern);
+    rows.insert(rows.end(), memories.back().words().begin(),
+                memories.back().words().end());
+  }
+  abc::MultiIndexHash index(n);
+  index.build(rows);
+
+  abc::BitPattern query = memories[17];
+  for (std::size_t i = 67; i < 192; i += 48) query.flip(i);  // rumore
+  std::vector<std::size_t> found;
+  const std::size_t threshold{index.candidates(rows, query.words(), 5, found)};
+  CHECK(threshold > 4);
+  CHECK(found.size() >= 5);
+  CHECK(found.size() <= 10);  // il solo gruppo della query
+  CHECK(std::find(found.begin(), found.end(), 17) != found.end());
+  // il limite dei cassetti vale per tutte le memorie scartate
+  const int bound{static_cast<int>(n) -
+                  2 * static_cast<int>(index.chunks() - threshold + 1)};
+  for (std::size_t m = 0; m < count; ++m) {
+    if (!std::binary_search(found.begin(), found.end(), m)) {
+      CHECK(abc::dot(memories[m], query) <= bound);
+    }
+  }
+}
+TEST_CASE("Image kernels") {
+  // immagine RGBA 4 x 3: grigio (10 * x + 60 * y) su tutti i canali
+  const std::size_t width{4};
+  const std::size_t height{3};
+  std::vector<std::uint8_t> pixels(width * height * 4);
+  for (std::size_t y = 0; y < height; ++y) {
+    for (std::size_t x = 0; x < width; ++x) {
+      for (std::size_t c = 0; c < 4; ++c) {
+        pixels[(y * width + x) * 4 + c] =
+            static_cast<std::uint8_t>(c == 3 ? 255 : 10 * x + 60 * y);
+      }
+    }
+  }
+
+  SUBCASE("Image kernels - area weights") {
+    const abc::AreaAxis axis(3, 2);  // ogni pixel copre 1.5 pixel sorgente
+    CHECK(axis.first == std::vector<std::size_t>{0, 1});
+    CHECK(axis.count(0) == 2);
+    CHECK(axis.weights[0] == doctest::Approx(2.0 / 3.0));
+    CHECK(axis.weights[1] == doctest::Approx(1.0 / 3.0));
+    CHECK(axis.weights[2] == doctest::Approx(1.0 / 3.0));
+    CHECK(axis.weights[3] == doctest::Approx(2.0 / 3.0));
+  }
+  SUBCASE("Image kernels - area average and threshold") {
+    std::vector<std::uint8_t> resized(2 * 2 * 4);
+    std::vector<int> pattern(4, 0);
+    abc::areaAverageThreshold(
+        pixels.data(), width, height, 2, resized,
+        [&](std::size_t i, int spin) { pattern[i] = spin; });
+    // riga 0: righe sorgente 0 (2/3) e 1 (1/3); colonna 0: colonne 0 e 1
+    CHECK(resized[0] == 25);   // 5 + 20
+    CHECK(resized[3] == 255);  // l'alfa resta opaco
+    CHECK(resized[(1 * 2 + 1) * 4] == 125);  // 25 + 100
+    // 3 * 125 = 375 < 381: tutti scuri
+    CHECK(pattern == std::vector<int>{1, 1, 1, 1});
+
+    // stessa dimensione: l'immagine non cambia
+    const std::vector<std::uint8_t> tiny{0,   0,   0,   255,  //
+                                         200, 200, 200, 255,  //
+                                         130, 130, 130, 255,  //
+                                         100, 90,  80,  255};
+    std::vector<std::uint8_t> copy(tiny.size());
+    abc::areaAverageThreshold(
+        tiny.data(), 2, 2, 2, copy,
+        [&](std::size_t i, int spin) { pattern[i] = spin; });
+    CHECK(copy == tiny);
+    CHECK(pattern == std::vector<int>{1, -1, -1, 1});
+  }
+  SUBCASE("Image kernels - bilinear like the per-pixel formula") {
+    // immagine casuale: il kernel separabile in float deve dare lo stesso
+    // pattern dei quattro getPixel per pixel in double
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+    const unsigned int w{37};
+    const unsigned int h{23};
+    std::vector<std::uint8_t> photo(w * h * 4);
+    for (auto& p : photo) {
+      p = static_cast<std::uint8_t>(byte(gen));
+    }
+    // come in adaptImage_withBilinearInterpolation, in unsigned int
+    auto gray = [&](unsigned int x, unsigned int y) {
+      const std::uint8_t* p = photo.data() + (y * w + x) * 4;
+      return (p[0] + p[1] + p[2]) / 3.0;
+    };
+    abc::BilinearResampler resampler;
+    for (const unsigned int dim : {16u, 50u, 16u}) {
+      const double xRatio{(w - 1) / static_cast<double>(dim - 1)};
+      const double yRatio{(h - 1) / static_cast<double>(dim - 1)};
+      std::vector<int> expected;
+      for (unsigned int y = 0; y < dim; ++y) {
+        for (unsigned int x = 0; x < dim; ++x) {
+          const double gx{xRatio * x};
+          const double gy{yRatio * y};
+          const auto xl = static_cast<unsigned int>(std::floor(gx));
+          const auto yl = static_cast<unsigned int>(std::floor(gy));
+          const unsigned int xh{
+              std::min(static_cast<unsigned int>(std::ceil(gx)), w - 1)};
+          const unsigned int yh{
+              std::min(static_cast<unsigned int>(std::ceil(gy)), h - 1)};
+          const double wx{gx - xl};
+          const double wy{gy - yl};
+          const double pixel{gray(xl, yl) * (1 - wx) * (1 - wy) +
+                             gray(xh, yl) * wx * (1 - wy) +
+                             gray(xl, yh) * (1 - wx) * wy +
+                             gray(xh, yh) * wx * wy};
+          expected.push_back(pixel < 127 ? 1 : -1);
+        }
+      }
+      std::vector<int> pattern(dim * dim, 0);
+      resampler.resize(photo.data(), w, h, dim,
+                       [&](std::size_t i, int spin) { pattern[i] = spin; });
+      CHECK(pattern == expected);
+      abc::BitPattern bits(dim * dim);
+      resampler.resize(photo.data(), w, h, dim,
+                       [&](std::size_t i, int spin) { bits.set(i, spin); });
+      CHECK(bits.toVector() == expected);
+    }
+  }
+  SUBCASE("Image kernels - rendering a pattern") {
+    // 70 spin: piu' di una parola e una coda che non riempie un nibble
+    std::vector<int> spins(70, -1);
+    for (std::size_t i = 0; i < spins.size(); i += 3) {
+      spins[i] = 1;
+    }
+    std::vector<std::uint8_t> expected;
+    for (int spin : spins) {
+      const auto& pixel = spin == 1 ? abc::kBlackPixel : abc::kWhitePixel;
+      expected.insert(expected.end(), pixel.begin(), pixel.end());
+    }
+    std::vector<std::uint8_t> rgba(spins.size() * 4, 7);
+    abc::renderPattern(spins, rgba);
+    CHECK(rgba == expected);
+    std::fill(rgba.begin(), rgba.end(), 7);
+    abc::renderPattern(abc::BitPattern(spins), rgba);
+    CHECK(rgba == expected);
+    CHECK(rgba[3] == 255);
+  }
+  SUBCASE("Image kernels - bilinear to a single pixel") {
+    // dim == 1: solo il pixel in alto a sinistra, senza dividere per zero
+    abc::BilinearResampler resampler;
+    int spin{0};
+    resampler.resize(pixels.data(), width, height, 1,
+                     [&](std::size_t, int s) { spin = s; });
+    CHECK(spin == 1);
+  }
+}
+
+TEST_CASE("PatternCache") {
+  // un file qualunque fa da immagine: la chiave guarda solo i byte
+  const abc::TempFile imageFile("pattern_cache_image.bin");
+  const abc::TempFile directory("pattern_cache_test");
+  const std::string image{imageFile.path()};
+  {
+    std::ofstream file(image, std::ios::binary);
+    file << "not really a png";
+  }
+  const abc::PatternCache cache(directory.path());
+  const abc::PatternKey key{
+      abc::patternKey(image, 10, abc::ResizeMethod::Bilinear)};
+  std::vector<int> spins(100, -1);
+  spins[0] = spins[63] = spins[64] = spins[99] = 1;
+  const abc::BitPattern pattern(spins);
+
+  SUBCASE("PatternCache - store and find") {
+    CHECK_FALSE(cache.find(key).has_value());
+    cache.store(key, pattern);
+    const auto found = cache.find(key);
+    REQUIRE(found.has_value());
+    CHECK(*found == pattern);
+    CHECK(std::distance(
+              std::filesystem::directory_iterator(cache.directory()),
+              std::filesystem::directory_iterator{}) == 1);
+  }
+  SUBCASE("PatternCache - every field is part of the key") {
+    cache.store(key, pattern);
+    CHECK_FALSE(cache
+                    .find(abc::patternKey(image, 20,
+                                          abc::ResizeMethod::Bilinear))
+                    .has_value());
+    CHECK_FALSE(
+        cache.find(abc::patternKey(image, 10, abc::ResizeMethod::Area))
+            .has_value());
+    {
+      std::ofstream file(image, std::ios::binary);
+      file << "not really a jpg";  // stessa lunghezza, altro contenuto
+    }
+    const abc::PatternKey changed{
+        abc::patternKey(image, 10, abc::ResizeMethod::Bilinear)};
+    CHECK(changed.fileSize == key.fileSize);
+    CHECK(changed.contentHash != key.contentHash);
+    CHECK_FALSE(cache.find(changed).has_value());
+  }
+  SUBCASE("PatternCache - a damaged entry is a miss") {
+    cache.store(key, pattern);
+    const auto entry =
+        *std::filesystem::directory_iterator(cache.directory());
+    std::filesystem::resize_file(entry.path(), 64 + 8);
+    CHECK_FALSE(cache.find(key).has_value());
+    cache.store(key, pattern);  // riscritta
+    CHECK(cache.find(key).has_value());
+
+    // un numero di bit assurdo nell'header non arriva all'allocazione
+    for (const std::uint64_t bits :
+         {std::uint64_t{1} << 62, std::uint64_t{64}}) {
+      {
+        std::fstream file(entry.path(),
+                          std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(offsetof(abc::PatternCacheHeader, bits));
+        file.write(reinterpret_cast<const char*>(&bits), sizeof(bits));
+      }
+      CHECK_FALSE(cache.find(key).has_value());
+    }
+  }
+  SUBCASE("PatternCache - missing image") {
+    CHECK_THROWS_WITH_AS(
+        abc::patternKey("missing.png", 10, abc::ResizeMethod::Bilinear),
+        "Input image not loaded, please check input path.",
+        std::runtime_error);
+  }
+}
@@ -0,0 +1,207 @@
+#ifndef HOPFIELDNEURALNETWORK_MATRIXFILE_H
+#define HOPFIELDNEURALNETWORK_MATRIXFILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// formato binario versionato per le matrici:
+// [header di 64 byte][rows * cols elementi row-major, nell'endianness nativa]
+// l'header e' lungo 64 byte cosi' il payload mappato resta allineato
+
+namespace abc {
+
+enum class FileFormat { Text, Binary };
+
+enum class MatrixDType : std::uint32_t {
+  Int32 = 1,
+  Float32 = 2,
+  Float64 = 3,
+  UInt64 = 4
+};
+
+// Dense: rows * cols elementi; SymmetricPacked: solo il triangolo superiore
+// stretto, rows * (rows - 1) / 2 elementi
+enum class MatrixLayout : std::uint32_t { Dense = 0, SymmetricPacked = 1 };
+
+template <class T>
+struct MatrixDTypeOf;
+template <>
+struct MatrixDTypeOf<int> {
+  static constexpr MatrixDType value{MatrixDType::Int32};
+};
+template <>
+struct MatrixDTypeOf<float> {
+  static constexpr MatrixDType value{MatrixDType::Float32};
+};
+template <>
+struct MatrixDTypeOf<double> {
+  static constexpr MatrixDType value{MatrixDType::Float64};
+};
+template <>
+struct MatrixDTypeOf<std::uint64_t> {
+  static constexpr MatrixDType value{MatrixDType::UInt64};
+};
+
+struct MatrixFileHeader {
+  static constexpr std::array<char, 8> kMagic{'H', 'O', 'P', 'F',
+                                              'M', 'A', 'T', '\0'};
+  static constexpr std::uint32_t kVersion{1};
+  static constexpr std::uint32_t kEndianTag{0x01020304};
+
+  std::array<char, 8> magic{kMagic};
+  std::uint32_t version{kVersion};
+  std::uint32_t endianTag{kEndianTag};  // letto al contrario se l'endianness
+                                        // del file non e' quella nativa
+  std::uint32_t dtype{0};
+  std::uint32_t elementSize{0};
+  std::uint64_t rows{0};
+  std::uint64_t cols{0};
+  std::uint64_t checksum{0};  // matrixChecksum del payload
+  std::uint32_t layout{0};
+  std::array<std::uint8_t, 12> reserved{};
+};
+static_assert(sizeof(MatrixFileHeader) == 64);
+
+inline std::uint32_t byteSwap32(std::uint32_t v) {
+  return ((v & 0x000000FFu) << 24) | ((v & 0x0000FF00u) << 8) |
+         ((v & 0x00FF0000u) >> 8) | ((v & 0xFF000000u) >> 24);
+}
+inline std::uint64_t byteSwap64(std::uint64_t v) {
+  return (static_cast<std::uint64_t>(byteSwap32(static_cast<std::uint32_t>(v)))
+          << 32) |
+         byteSwap32(static_cast<std::uint32_t>(v >> 32));
+}
+inline void byteSwapHeader(MatrixFileHeader& h) {
+  h.version = byteSwap32(h.version);
+  h.endianTag = byteSwap32(h.endianTag);
+  h.dtype = byteSwap32(h.dtype);
+  h.elementSize = byteSwap32(h.elementSize);
+  h.rows = byteSwap64(h.rows);
+  h.cols = byteSwap64(h.cols);
+  h.checksum = byteSwap64(h.checksum);
+  h.layout = byteSwap32(h.layout);
+}
+// inverte l'ordine dei byte di ogni elemento del payload
+inline void byteSwapPayload(unsigned char* bytes, std::size_t count,
+                            std::size_t elementSize) {
+  for (std::size_t i = 0; i < count; ++i) {
+    unsigned char* e = bytes + i * elementSize;
+    for (std::size_t b = 0; b < elementSize / 2; ++b) {
+      std::swap(e[b], e[elementSize - 1 - b]);
+    }
+  }
+}
+
+// hash con lo schema di FNV-1a (xor, poi moltiplicazione per il primo FNV a
+// 64 bit) applicato a parole da 8 byte, e a byte singoli solo per la coda.
+// Non e' FNV-1a standard, che procede un byte alla volta: cosi' e' abbastanza
+// veloce da poter essere verificato anche su matrici da centinaia di MB
+inline std::uint64_t matrixChecksum(const void* data, std::size_t bytes) {
+  constexpr std::uint64_t prime{0x100000001b3ull};
+  std::uint64_t hash{0xcbf29ce484222325ull};
+  const auto* p = static_cast<const unsigned char*>(data);
+  std::size_t i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, p + i, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for (; i < bytes; ++i) {
+    hash = (hash ^ p[i]) * prime;
+  }
+  return hash;
+}
+
+// numero di elementi da due dimensioni lette da un header: un header
+// corrotto o costruito ad arte non deve far traboccare il conto
+inline std::size_t checkedProduct(std::uint64_t a, std::uint64_t b) {
+  if (a != 0 && b > std::numeric_limits<std::size_t>::max() / a) {
+    throw std::runtime_error("Binary matrix file header is corrupted!");
+  }
+  return static_cast<std::size_t>(a * b);
+}
+
+// legge e valida l'header; ritorna true se il file ha endianness opposta
+inline bool readMatrixHeader(std::istream& in, MatrixFileHeader& header) {
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    throw std::runtime_error("Not a valid binary matrix file!");
+  }
+  if (header.magic != MatrixFileHeader::kMagic) {
+    throw std::runtime_error("Not a valid binary matrix file!");
+  }
+  bool swapped{false};
+  if (header.endianTag != MatrixFileHeader::kEndianTag) {
+    byteSwapHeader(header);
+    if (header.endianTag != MatrixFileHeader::kEndianTag) {
+      throw std::runtime_error("Not a valid binary matrix file!");
+    }
+    swapped = true;
+  }
+  if (header.version != MatrixFileHeader::kVersion) {
+    throw std::runtime_error("Unsupported binary matrix file version!");
+  }
+  return swapped;
+}
+
+inline bool isBinaryMatrixFile(const std::string& filepath) {
+  std::ifstream file(filepath, std::ios::binary);
+  std::array<char, 8> magic{};
+  if (!file.read(magic.data(), magic.size())) {
+    return false;
+  }
+  return magic == MatrixFileHeader::kMagic;
+}
+
+// mappatura read-only di un file (MAP_PRIVATE: le scritture restano locali al
+// processo e non toccano il file)
+class MappedFile {
+ private:
+  void* address_{MAP_FAILED};
+  std::size_t length_{0};
+
+ public:
+  explicit MappedFile(const std::string& filepath) {
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open the file!");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+      ::close(fd);
+      throw std::runtime_error("Cannot map the file!");
+    }
+    length_ = static_cast<std::size_t>(info.st_size);
+    address_ = ::mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    ::close(fd);
+    if (address_ == MAP_FAILED) {
+      throw std::runtime_error("Cannot map the file!");
+    }
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (address_ != MAP_FAILED) {
+      ::munmap(address_, length_);
+    }
+  }
+
+  unsigned char* data() const { return static_cast<unsigned char*>(address_); }
+  std::size_t size() const { return length_; }
+};
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef HOPFIELDNEURALNETWORK_MATRIXSTORAGE_H
+#define HOPFIELDNEURALNETWORK_MATRIXSTORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MatrixFile.hpp"
+
+namespace abc {
+
+// allocator che allinea il buffer alla cache line, cosi' le righe lunghe
+// possono essere lette con load allineati
+template <class T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+  using value_type = T;
+
+  template <class U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <class U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+  }
+  void deallocate(T* p, std::size_t) {
+    ::operator delete(p, std::align_val_t{Alignment});
+  }
+
+  template <class U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const {
+    return true;
+  }
+};
+
+// buffer contiguo di elementi, proprio oppure mappato da un file binario.
+// E' la base comune di Matrix e SymmetricMatrix: loro decidono il significato
+// degli indici, qui si gestiscono memoria e formato su disco
+template <class T>
+class MatrixStorage {
+ private:
+  // ptr_ punta a data_ oppure, dopo map(), direttamente nel file mappato
+  std::vector<T, AlignedAllocator<T>> data_;
+  std::shared_ptr<const MappedFile> mapping_;
+  T* ptr_{nullptr};
+  std::size_t size_{0};
+
+  static void checkHeaderType(const MatrixFileHeader& header,
+                              MatrixLayout layout) {
+    if (header.dtype != static_cast<std::uint32_t>(MatrixDTypeOf<T>::value) ||
+        header.elementSize != sizeof(T)) {
+      throw std::runtime_error("Binary file element type does not match!");
+    }
+    if (header.layout != static_cast<std::uint32_t>(layout)) {
+      throw std::runtime_error("Binary file layout does not match!");
+    }
+  }
+  // byte del payload dichiarato dall'header, controllati contro la lunghezza
+  // del file prima di allocare, leggere o mappare
+  static std::size_t payloadBytes(std::size_t count, std::uintmax_t fileSize) {
+    if (count > (std::numeric_limits<std::size_t>::max() -
+                 sizeof(MatrixFileHeader)) /
+                    sizeof(T)) {
+      throw std::runtime_error("Binary matrix file header is corrupted!");
+    }
+    const std::size_t bytes{count * sizeof(T)};
+    if (fileSize < sizeof(MatrixFileHeader) + bytes) {
+      throw std::runtime_error("Binary matrix file is truncated!");
+    }
+    return bytes;
+  }
+
+ public:
+  MatrixStorage() {}
+  MatrixStorage(std::size_t size, T value)
+      : data_(size, value), ptr_{data_.data()}, size_{size} {}
+  // le copie hanno sempre un buffer proprio, anche se l'originale e' mappato
+  MatrixStorage(const MatrixStorage& other)
+      : data_(other.ptr_, other.ptr_ + other.size_),
+        ptr_{data_.data()},
+        size_{other.size_} {}
+  MatrixStorage(MatrixStorage&& other) noexcept
+      : data_(std::move(other.data_)),
+        mapping_(std::move(other.mapping_)),
+        ptr_{std::exchange(other.ptr_, nullptr)},
+        size_{std::exchange(other.size_, 0)} {}
+  MatrixStorage& operator=(MatrixStorage other) noexcept {
+    data_ = std::move(other.data_);
+    mapping_ = std::move(other.mapping_);
+    ptr_ = std::exchange(other.ptr_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+  }
+
+  T* data() { return ptr_; }
+  const T* data() const { return ptr_; }
+  std::size_t size() const { return size_; }
+  bool isMapped() const { return static_cast<bool>(mapping_); }
+
+  // copia il contenuto mappato in un buffer proprio
+  void detach() {
+    if (mapping_) {
+      data_.assign(ptr_, ptr_ + size_);
+      ptr_ = data_.data();
+      mapping_.reset();
+    }
+  }
+  void resize(std::size_t size, T value = T{}) {
+    detach();
+    data_.resize(size, value);
+    ptr_ = data_.data();
+    size_ = size;
+  }
+
+  void save(const std::string& filepath, MatrixLayout layout,
+            std::uint64_t rows, std::uint64_t cols) const {
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error("Cannot create the file!");
+    }
+    const std::size_t bytes{size_ * sizeof(T)};
+    MatrixFileHeader header;
+    header.dtype = static_cast<std::uint32_t>(MatrixDTypeOf<T>::value);
+    header.elementSize = sizeof(T);
+    header.rows = rows;
+    header.cols = cols;
+    header.checksum = matrixChecksum(ptr_, bytes);
+    header.layout = static_cast<std::uint32_t>(layout);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(ptr_),
+               static_cast<std::streamsize>(bytes));
+    if (!file) {
+      throw std::runtime_error("Cannot write the file!");
+    }
+  }
+
+  // elementCount(header) controlla le dimensioni lette e ritorna il numero di
+  // elementi attesi nel payload
+  template <class ElementCount>
+  MatrixFileHeader load(const std::string& filepath, MatrixLayout layout,
+                        bool verifyChecksum, ElementCount elementCount) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error("Cannot open the file!");
+    }
+    MatrixFileHeader header;
+    const bool swapped{readMatrixHeader(file, header)};
+    checkHeaderType(header, layout);
+
+    const std::size_t count{elementCount(header)};
+    const std::size_t bytes{
+        payloadBytes(count, std::filesystem::file_size(filepath))};
+    std::vector<T, AlignedAllocator<T>> values(count);
+    if (!file.read(reinterpret_cast<char*>(values.data()),
+                   static_cast<std::streamsize>(bytes))) {
+      throw std::runtime_error("Binary matrix file is truncated!");
+    }
+    if (verifyChecksum &&
+        matrixChecksum(values.data(), bytes) != header.checksum) {
+      throw std::runtime_error("Binary matrix file checksum mismatch!");
+    }
+    if (swapped) {
+      byteSwapPayload(reinterpret_cast<unsigned char*>(values.data()),
+                      values.size(), sizeof(T));
+    }
+    mapping_.reset();
+    data_ = std::move(values);
+    ptr_ = data_.data();
+    size_ = data_.size();
+    return header;
+  }
+
+  // carica senza copie: gli elementi vengono letti direttamente dalle pagine
+  // del file. Le modifiche restano private al processo (MAP_PRIVATE)
+  template <class ElementCount>
+  MatrixFileHeader map(const std::string& filepath, MatrixLayout layout,
+                       bool verifyChecksum, ElementCount elementCount) {
+    auto mapping = std::make_shared<const MappedFile>(filepath);
+    if (mapping->size() < sizeof(MatrixFileHeader)) {
+      throw std::runtime_error("Not a valid binary matrix file!");
+    }
+    MatrixFileHeader header;
+    std::memcpy(&header, mapping->data(), sizeof(header));
+    if (header.magic != MatrixFileHeader::kMagic) {
+      throw std::runtime_error("Not a valid binary matrix file!");
+    }
+    if (header.endianTag != MatrixFileHeader::kEndianTag) {
+      // payload da convertire: niente mappatura diretta
+      return load(filepath, layout, verifyChecksum, elementCount);
+    }
+    if (header.version != MatrixFileHeader::kVersion) {
+      throw std::runtime_error("Unsupported binary matrix file version!");
+    }
+    checkHeaderType(header, layout);
+    const std::size_t count{elementCount(header)};
+    const std::size_t bytes{payloadBytes(count, mapping->size())};
+    unsigned char* payload = mapping->data() + sizeof(MatrixFileHeader);
+    if (verifyChecksum && matrixChecksum(payload, bytes) != header.checksum) {
+      throw std::runtime_error("Binary matrix file checksum mismatch!");
+    }
+
+    data_.clear();
+    data_.shrink_to_fit();
+    mapping_ = std::move(mapping);
+    ptr_ = reinterpret_cast<T*>(payload);
+    size_ = count;
+    return header;
+  }
+};
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef HOPFIELDNEURALNETWORK_MEMORYINDEX_H
+#define HOPFIELDNEURALNETWORK_MEMORYINDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "BitPattern.hpp"
+
+namespace abc {
+
+// multi-index hashing su pattern impacchettati: ogni pattern e' diviso in
+// sottostringhe da 16 bit e ogni sottostringa ha la sua tabella. L'indice
+// tiene solo gli id delle memorie: le chiavi si leggono dalle righe
+// impacchettate (rows, size() righe da bitWords(bits()) parole, contigue),
+// passate a ogni chiamata perche' chi le possiede puo' riallocarle.
+// candidates() conta per ogni memoria le sottostringhe uguali alla query e
+// tiene quelle con piu' corrispondenze: per il principio dei cassetti una
+// memoria con meno di t sottostringhe uguali differisce in almeno
+// chunks() - t + 1 bit, cioe' ha overlap <= bits() - 2 * (chunks() - t + 1).
+// Dopo build() l'indice non cambia: le ricerche scrivono solo nel loro
+// SearchWorkspace, e piu' thread possono cercare nello stesso indice
+class MultiIndexHash {
+ public:
+  static constexpr std::size_t kChunkBits{16};
+
+  // corrispondenze per memoria nella ricerca corrente (tutte a zero fra una
+  // ricerca e l'altra) e memorie toccate, riusate fra le ricerche
+  struct SearchWorkspace {
+    std::vector<std::uint16_t> matches;
+    std::vector<std::uint32_t> touched;
+    std::vector<std::size_t> histogram;
+  };
+
+ private:
+  std::size_t bits_{0};
+  std::size_t chunks_{0};
+  std::size_t size_{0};
+  // per ogni sottostringa (blocchi da size_) gli id ordinati per chiave
+  std::vector<std::uint32_t> ids_;
+
+  static std::uint16_t chunk(std::span<const std::uint64_t> words,
+                             std::size_t c) {
+    return static_cast<std::uint16_t>(words[c / 4] >> (kChunkBits * (c % 4)));
+  }
+  std::uint16_t key(std::span<const std::uint64_t> rows, std::uint32_t id,
+                    std::size_t c) const {
+    const std::size_t words{bitWords(bits_)};
+    return chunk(rows.subspan(id * words, words), c);
+  }
+
+ public:
+  MultiIndexHash() {}
+  explicit MultiIndexHash(std::size_t bits)
+      : bits_{bits}, chunks_{(bits + kChunkBits - 1) / kChunkBits} {}
+
+  std::size_t bits() const { return bits_; }
+  std::size_t chunks() const { return chunks_; }
+  std::size_t size() const { return size_; }
+
+  // indicizza tutte le righe di rows: si ricostruisce a blocchi, dopo che le
+  // memorie sono state imparate
+  void build(std::span<const std::uint64_t> rows) {
+    const std::size_t words{bitWords(bits_)};
+    if (words == 0 || rows.size() % words != 0) {
+      throw std::runtime_error("Memory index: pattern size mismatch");
+    }
+    size_ = rows.size() / words;
+    ids_.resize(chunks_ * size_);
+    for (std::size_t c = 0; c < chunks_; ++c) {
+      const auto table = ids_.begin() + static_cast<std::ptrdiff_t>(c * size_);
+      for (std::size_t id = 0; id < size_; ++id) {
+        table[static_cast<std::ptrdiff_t>(id)] = static_cast<std::uint32_t>(id);
+      }
+      std::stable_sort(table, table + static_cast<std::ptrdiff_t>(size_),
+                       [&](std::uint32_t a, std::uint32_t b) {
+                         return key(rows, a, c) < key(rows, b, c);
+                       });
+    }
+  }
+  void clear() {
+    ids_.clear();
+    size_ = 0;
+  }
+
+  // indici (crescenti) delle memorie con almeno t sottostringhe uguali alla
+  // query, con t il piu' grande che ne lascia almeno want (t >= 1). Ritorna
+  // t, 0 se nessuna memoria ha sottostringhe uguali
+  std::size_t candidates(std::span<const std::uint64_t> rows,
+                         std::span<const std::uint64_t> query,
+                         std::size_t want, std::vector<std::size_t>& out,
+                         SearchWorkspace& work) const {
+    if (query.size() != bitWords(bits_) ||
+        rows.size() != size_ * bitWords(bits_)) {
+      throw std::runtime_error("Memory index: pattern size mismatch");
+    }
+    if (work.matches.size() != size_) {
+      work.matches.assign(size_, 0);
+    }
+    work.touched.clear();
+    for (std::size_t c = 0; c < chunks_; ++c) {
+      const std::uint32_t* table = ids_.data() + c * size_;
+      const std::uint16_t k{chunk(query, c)};
+      const std::uint32_t* first = std::lower_bound(
+          table, table + size_, k, [&](std::uint32_t id, std::uint16_t q) {
+            return key(rows, id, c) < q;
+          });
+      for (; first != table + size_ && key(rows, *first, c) == k; ++first) {
+        if (work.matches[*first]++ == 0) {
+          work.touched.push_back(*first);
+        }
+      }
+    }
+
+    // soglia: quante memorie hanno almeno t corrispondenze, per ogni t
+    work.histogram.assign(chunks_ + 2, 0);
+    for (const std::uint32_t id : work.touched) {
+      ++work.histogram[work.matches[id]];
+    }
+    std::size_t threshold{work.touched.empty() ? 0 : chunks_};
+    for (std::size_t atLeast{work.histogram[threshold]};
+         threshold > 1 && atLeast < want;
+         atLeast += work.histogram[threshold]) {
+      --threshold;
+    }
+
+    out.clear();
+    for (const std::uint32_t id : work.touched) {
+      if (work.matches[id] >= threshold) {
+        out.push_back(id);
+      }
+      work.matches[id] = 0;
+    }
+    std::sort(out.begin(), out.end());
+    return threshold;
+  }
+  // versione con un workspace temporaneo, per le ricerche isolate
+  std::size_t candidates(std::span<const std::uint64_t> rows,
+                         std::span<const std::uint64_t> query,
+                         std::size_t want,
+                         std::vector<std::size_t>& out) const {
+    SearchWorkspace work;
+    return candidates(rows, query, want, out, work);
+  }
+};
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef HOPFIELDNEURALNETWORK_PARALLEL_H
+#define HOPFIELDNEURALNETWORK_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace abc {
+
+// numero di thread da usare: 0 significa "tutti i core disponibili"
+inline unsigned int resolveThreadCount(unsigned int nThreads) {
+  if (nThreads == 0) {
+    nThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return nThreads;
+}
+
+// esegue body(i) per ogni i in [0, count). Gli indici sono distribuiti
+// dinamicamente (contatore atomico), quindi i task possono avere costi diversi.
+// body non deve lanciare eccezioni
+template <class Body>
+void parallelFor(std::size_t count, Body body, unsigned int nThreads = 0) {
+  const std::size_t workers{
+      std::min<std::size_t>(resolveThreadCount(nThreads), count)};
+  if (workers <= 1) {
+    for (std::size_t i = 0; i < count; ++i) {
+      body(i);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  auto work = [&]() {
+    for (std::size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+      body(i);
+    }
+  };
+  std::vector<std::jthread> threads;
+  threads.reserve(workers - 1);
+  for (std::size_t t = 1; t < workers; ++t) {
+    threads.emplace_back(work);
+  }
+  work();  // anche il thread chiamante lavora
+}
+
+// thread che restano vivi fra un run() e l'altro: per il recupero sincrono
+// si lancia un lavoro a ogni sweep, e creare i thread ogni volta costerebbe
+// quanto lo sweep stesso per N piccoli
+class ThreadPool {
+ private:
+  std::vector<std::jthread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::mutex runMutex_;  // un solo run() alla volta
+
+  // lavoro corrente, protetto da mutex_
+  std::function<void(std::size_t, unsigned int)> job_;
+  std::size_t count_{0};
+  std::atomic<std::size_t> next_{0};
+  unsigned long generation_{0};
+  unsigned int busy_{0};
+  bool stop_{false};
+
+  void work(unsigned int worker) {
+    for (std::size_t i = next_.fetch_add(1); i < count_;
+         i = next_.fetch_add(1)) {
+      job_(i, worker);
+    }
+  }
+  void loop(unsigned int worker) {
+    unsigned long seen{0};
+    while (true) {
+      {
+        std::unique_lock lock(mutex_);
+        wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+        if (stop_) {
+          return;
+        }
+        seen = generation_;
+      }
+      work(worker);
+      std::lock_guard lock(mutex_);
+      if (--busy_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+ public:
+  // nThreads conta anche il thread che chiama run(); 0 = tutti i core
+  explicit ThreadPool(unsigned int nThreads = 0) {
+    const unsigned int total{resolveThreadCount(nThreads)};
+    workers_.reserve(total - 1);
+    for (unsigned int w = 1; w < total; ++w) {
+      workers_.emplace_back([this, w]() { loop(w); });
+    }
+  }
+  ~ThreadPool() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    workers_.clear();  // join prima di distruggere mutex e condition variable
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned int size() const {
+    return static_cast<unsigned int>(workers_.size()) + 1;
+  }
+
+  // come parallelFor, ma body(i, worker) riceve anche l'indice del thread
+  // (0 ... size() - 1), utile per i buffer privati. body non deve lanciare
+  // eccezioni
+  template <class Body>
+  void run(std::size_t count, Body body) {
+    std::lock_guard runLock(runMutex_);
+    if (workers_.empty() || count <= 1) {
+      for (std::size_t i = 0; i < count; ++i) {
+        body(i, 0u);
+      }
+      return;
+    }
+    {
+      std::lock_guard lock(mutex_);
+      job_ = body;
+      count_ = count;
+      next_ = 0;
+      busy_ = static_cast<unsigned int>(workers_.size());
+      ++generation_;
+    }
+    wake_.notify_all();
+    work(0);  // anche il thread chiamante lavora
+    std::unique_lock lock(mutex_);
+    done_.wait(lock, [&]() { return busy_ == 0; });
+    job_ = nullptr;
+  }
+};
+
+// coda a capacita' limitata fra gli stadi di una pipeline: push() aspetta
+// se la coda e' piena, cosi' uno stadio veloce non riempie la memoria. Dopo
+// close() pop() svuota la coda e poi ritorna std::nullopt
+template <class T>
+class BoundedQueue {
+ private:
+  std::deque<T> items_;
+  std::size_t capacity_;
+  bool closed_{false};
+  std::mutex mutex_;
+  std::condition_variable notFull_;
+  std::condition_variable notEmpty_;
+
+ public:
+  explicit BoundedQueue(std::size_t capacity)
+      : capacity_{std::max<std::size_t>(1, capacity)} {}
+
+  // false se la coda e' stata chiusa: l'elemento non e' stato inserito
+  bool push(T item) {
+    std::unique_lock lock(mutex_);
+    notFull_.wait(lock, [&]() { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    notEmpty_.notify_one();
+    return true;
+  }
+  std::optional<T> pop() {
+    std::unique_lock lock(mutex_);
+    notEmpty_.wait(lock, [&]() { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    T item{std::move(items_.front())};
+    items_.pop_front();
+    notFull_.notify_one();
+    return item;
+  }
+  // niente piu' push: chi aspetta viene svegliato
+  void close() {
+    {
+      std::lock_guard lock(mutex_);
+      closed_ = true;
+    }
+    notFull_.notify_all();
+    notEmpty_.notify_all();
+  }
+};
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef HOPFIELDNEURALNETWORK_PATTERNCACHE_H
+#define HOPFIELDNEURALNETWORK_PATTERNCACHE_H
+
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "BitPattern.hpp"
+#include "MatrixFile.hpp"
+
+// cache su disco dei pattern gia' ridotti e binarizzati: un file per
+// (immagine, lato, metodo), con il pattern impacchettato a 1 bit per pixel.
+// Decodificare un JPEG costa molto piu' che rileggerlo per calcolarne l'hash
+
+namespace abc {
+
+// come l'immagine e' stata ridotta: adaptImage_withSFML o bilineare
+enum class ResizeMethod : std::uint32_t { Area = 1, Bilinear = 2 };
+
+// contenuto, dimensione e data di modifica del file immagine, lato del
+// pattern e metodo di riduzione
+struct PatternKey {
+  std::uint64_t contentHash{0};
+  std::uint64_t fileSize{0};
+  std::int64_t modified{0};  // nanosecondi dall'epoca del filesystem
+  std::uint32_t dimension{0};
+  std::uint32_t method{0};
+
+  bool operator==(const PatternKey& other) const = default;
+};
+static_assert(sizeof(PatternKey) == 32);
+
+inline PatternKey patternKey(const std::string& filepath,
+                             unsigned int dimension, ResizeMethod method) {
+  std::error_code error;
+  const auto size = std::filesystem::file_size(filepath, error);
+  const auto modified = std::filesystem::last_write_time(filepath, error);
+  if (error) {
+    throw std::runtime_error(
+        "Input image not loaded, please check input path.");
+  }
+  PatternKey key;
+  key.fileSize = size;
+  key.modified = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     modified.time_since_epoch())
+                     .count();
+  key.dimension = dimension;
+  key.method = static_cast<std::uint32_t>(method);
+  if (size > 0) {
+    const MappedFile file(filepath);
+    key.contentHash = matrixChecksum(file.data(), file.size());
+  }
+  return key;
+}
+
+struct PatternCacheHeader {
+  static constexpr std::array<char, 8> kMagic{'H', 'O', 'P', 'F',
+                                              'P', 'A', 'T', '\0'};
+  static constexpr std::uint32_t kVersion{1};
+
+  std::array<char, 8> magic{kMagic};
+  std::uint32_t version{kVersion};
+  std::uint32_t reserved{0};
+  PatternKey key;             // intera: il nome del file ne e' solo l'hash
+  std::uint64_t bits{0};
+  std::uint64_t checksum{0};  // matrixChecksum delle parole
+};
+static_assert(sizeof(PatternCacheHeader) == 64);
+
+// un file illeggibile, troncato o di un'altra chiave e' un miss e viene
+// riscritto. Le scritture passano da un file temporaneo rinominato, cosi'
+// piu' thread o processi possono usare la stessa cartella
+class PatternCache {
+ private:
+  std::filesystem::path directory_;
+
+  std::filesystem::path entry(const PatternKey& key) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0')
+         << matrixChecksum(&key, sizeof(key)) << ".pat";
+    return directory_ / name.str();
+  }
+
+ public:
+  explicit PatternCache(const std::string& directory)
+      : directory_{directory} {
+    std::filesystem::create_directories(directory_);
+  }
+
+  const std::filesystem::path& directory() const { return directory_; }
+
+  std::optional<BitPattern> find(const PatternKey& key) const {
+    const std::filesystem::path path{entry(key)};
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    std::ifstream file(path, std::ios::binary);
+    PatternCacheHeader header;
+    if (error || !file ||
+        !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != PatternCacheHeader::kMagic ||
+        header.version != PatternCacheHeader::kVersion || header.key != key) {
+      return std::nullopt;
+    }
+    // bits viene dal file: prima di allocare deve essere il lato richiesto al
+    // quadrato e stare nel file, altrimenti la voce e' rovinata
+    const std::uint64_t side{key.dimension};
+    if (header.bits != side * side ||
+        size != sizeof(header) + bitWords(header.bits) * 8) {
+      return std::nullopt;
+    }
+    std::vector<std::uint64_t> words(bitWords(header.bits));
+    if (!file.read(reinterpret_cast<char*>(words.data()),
+                   static_cast<std::streamsize>(words.size() * 8)) ||
+        matrixChecksum(words.data(), words.size() * 8) != header.checksum) {
+      return std::nullopt;
+    }
+    return BitPattern(header.bits, words);
+  }
+
+  void store(const PatternKey& key, const BitPattern& pattern) const {
+    static std::atomic<unsigned long> counter{0};
+    PatternCacheHeader header;
+    header.key = key;
+    header.bits = pattern.size();
+    header.checksum =
+        matrixChecksum(pattern.words().data(), pattern.words().size() * 8);
+    const std::filesystem::path path{entry(key)};
+    std::filesystem::path temporary{path};
+    temporary += ".tmp" + std::to_string(::getpid()) + "_" +
+                 std::to_string(counter++);
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(pattern.words().data()),
+               static_cast<std::streamsize>(pattern.words().size() * 8));
+    file.close();
+    if (!file) {
+      std::error_code ignored;
+      std::filesystem::remove(temporary, ignored);
+      throw std::runtime_error("Cannot create the file!");
+    }
+    std::filesystem::rename(temporary, path);
+  }
+};
+
+}  // namespace abc
+
+#endif
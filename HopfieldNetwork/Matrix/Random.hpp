@@ -0,0 +1,242 @@
+#ifndef HOPFIELDNEURALNETWORK_RANDOM_H
+#define HOPFIELDNEURALNETWORK_RANDOM_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace abc {
+
+// seme usato quando nessuno ne sceglie uno: le esecuzioni sono ripetibili
+inline constexpr std::uint64_t kDefaultSeed{0x9e3779b97f4a7c15ull};
+
+// espande un seme a 64 bit in stati ben distribuiti (consigliato dagli autori
+// di xoshiro per l'inizializzazione)
+inline std::uint64_t splitMix64(std::uint64_t& state) {
+  std::uint64_t z{state += 0x9e3779b97f4a7c15ull};
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// uniforme in [0, 1) dai 53 bit alti
+inline double toUniform(std::uint64_t x) {
+  return static_cast<double>(x >> 11) * 0x1.0p-53;
+}
+
+// xoshiro256++: 256 bit di stato, pochi cicli per numero, nessuna chiamata
+// di sistema. Soddisfa UniformRandomBitGenerator, quindi funziona anche con
+// le distribuzioni di <random>
+class Xoshiro256 {
+ private:
+  std::array<std::uint64_t, 4> s_{};
+
+ public:
+  using result_type = std::uint64_t;
+
+  explicit Xoshiro256(std::uint64_t seed = kDefaultSeed) { this->seed(seed); }
+  void seed(std::uint64_t seed) {
+    for (auto& word : s_) {
+      word = splitMix64(seed);
+    }
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~result_type{0}; }
+  result_type operator()() {
+    const std::uint64_t result{std::rotl(s_[0] + s_[3], 23) + s_[0]};
+    const std::uint64_t t{s_[1] << 17};
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = std::rotl(s_[3], 45);
+    return result;
+  }
+  double uniform() { return toUniform((*this)()); }
+  const std::array<std::uint64_t, 4>& state() const { return s_; }
+
+  // avanza di 2^128 passi: generatori ottenuti con jump() successivi danno
+  // sequenze che non si sovrappongono (uno per thread)
+  void jump() {
+    constexpr std::array<std::uint64_t, 4> kJump{
+        0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull,
+        0x39abdc4529b1661cull};
+    std::array<std::uint64_t, 4> next{};
+    for (const std::uint64_t word : kJump) {
+      for (int b = 0; b < 64; ++b) {
+        if (word & (std::uint64_t{1} << b)) {
+          for (std::size_t k = 0; k < 4; ++k) {
+            next[k] ^= s_[k];
+          }
+        }
+        (*this)();
+      }
+    }
+    s_ = next;
+  }
+};
+
+// intero uniforme in [0, bound) senza distorsione: si scartano i valori
+// sotto 2^64 mod bound. Non dipende dalla libreria standard come
+// std::uniform_int_distribution, quindi lo stesso seme da' gli stessi indici
+inline std::uint64_t uniformBelow(Xoshiro256& generator, std::uint64_t bound) {
+  const std::uint64_t threshold{(0 - bound) % bound};
+  for (;;) {
+    const std::uint64_t x{generator()};
+    if (x >= threshold) {
+      return x % bound;
+    }
+  }
+}
+
+// k indici distinti di [0, n) in O(k): Fisher-Yates parziale su una
+// permutazione riusata fra le chiamate, rimessa all'identita' disfacendo gli
+// scambi. Solo la prima chiamata con un n piu' grande costa O(n)
+class DistinctSampler {
+ private:
+  std::vector<std::uint32_t> permutation_;
+  std::vector<std::uint32_t> swaps_;
+
+ public:
+  // visit(i) per ogni indice estratto, nell'ordine di estrazione
+  template <class Visit>
+  void sample(std::size_t n, std::size_t k, Xoshiro256& generator,
+              Visit visit) {
+    if (k > n) {
+      throw std::runtime_error("Cannot sample more indices than available.");
+    }
+    for (std::size_t i = permutation_.size(); i < n; ++i) {
+      permutation_.push_back(static_cast<std::uint32_t>(i));
+    }
+    swaps_.resize(k);
+    for (std::size_t i = 0; i < k; ++i) {
+      const std::size_t j{i + uniformBelow(generator, n - i)};
+      std::swap(permutation_[i], permutation_[j]);
+      swaps_[i] = static_cast<std::uint32_t>(j);
+      visit(static_cast<std::size_t>(permutation_[i]));
+    }
+    for (std::size_t i = k; i-- > 0;) {
+      std::swap(permutation_[i], permutation_[swaps_[i]]);
+    }
+  }
+};
+
+// quattro xoshiro256++ indipendenti che avanzano insieme. Lo stato e'
+// trasposto (una parola per lane in ogni array), cosi' il passo e' lo stesso
+// codice su 4 lane e il compilatore lo vettorizza
+class Xoshiro256x4 {
+ private:
+  static constexpr std::size_t kLanes{4};
+  std::array<std::uint64_t, kLanes> s0_{}, s1_{}, s2_{}, s3_{};
+
+ public:
+  explicit Xoshiro256x4(std::uint64_t seed = kDefaultSeed) {
+    this->seed(seed);
+  }
+  void seed(std::uint64_t seed) {
+    Xoshiro256 lane(seed);
+    for (std::size_t k = 0; k < kLanes; ++k) {
+      // la lane k e' il generatore scalare dopo k salti di 2^128 passi: le
+      // quattro sequenze non si sovrappongono
+      const auto& s = lane.state();
+      s0_[k] = s[0];
+      s1_[k] = s[1];
+      s2_[k] = s[2];
+      s3_[k] = s[3];
+      lane.jump();
+    }
+  }
+
+  // riempie out con uniformi in [0, 1), 4 alla volta
+  void fillUniform(std::span<double> out) {
+    std::size_t i{0};
+    std::array<std::uint64_t, kLanes> result{};
+    while (i < out.size()) {
+      for (std::size_t k = 0; k < kLanes; ++k) {
+        result[k] = std::rotl(s0_[k] + s3_[k], 23) + s0_[k];
+        const std::uint64_t t{s1_[k] << 17};
+        s2_[k] ^= s0_[k];
+        s3_[k] ^= s1_[k];
+        s1_[k] ^= s2_[k];
+        s0_[k] ^= s3_[k];
+        s2_[k] ^= t;
+        s3_[k] = std::rotl(s3_[k], 45);
+      }
+      for (std::size_t k = 0; k < kLanes && i < out.size(); ++k, ++i) {
+        out[i] = toUniform(result[k]);
+      }
+    }
+  }
+};
+
+// uniformi in [0, 1) prodotte a blocchi con Xoshiro256x4 e consumate una
+// alla volta: e' il generatore dei test di accettazione dell'annealing. Con
+// lo stesso seme la sequenza e' sempre la stessa
+class UniformStream {
+ private:
+  Xoshiro256x4 generator_;
+  std::vector<double> block_;
+  std::size_t next_;
+
+ public:
+  explicit UniformStream(std::uint64_t seed = kDefaultSeed,
+                         std::size_t blockSize = 1024)
+      : generator_(seed), block_(blockSize), next_{blockSize} {}
+
+  void seed(std::uint64_t seed) {
+    generator_.seed(seed);
+    next_ = block_.size();
+  }
+  double operator()() {
+    if (next_ == block_.size()) {
+      generator_.fillUniform(block_);
+      next_ = 0;
+    }
+    return block_[next_++];
+  }
+  // blocco di uniformi in una volta sola
+  void fill(std::span<double> out) { generator_.fillUniform(out); }
+};
+
+// seme dello stream numero index derivato da un seme comune: thread diversi
+// ricevono sequenze diverse ma ripetibili
+inline std::uint64_t streamSeed(std::uint64_t seed, std::uint64_t index) {
+  std::uint64_t state{seed ^ (index * 0xd1b54a32d192ed03ull)};
+  return splitMix64(state);
+}
+
+namespace detail {
+inline std::atomic<std::uint64_t>& threadSeedBase() {
+  static std::atomic<std::uint64_t> base{kDefaultSeed};
+  return base;
+}
+inline std::atomic<std::uint64_t>& threadCounter() {
+  static std::atomic<std::uint64_t> counter{0};
+  return counter;
+}
+}  // namespace detail
+
+// stream del thread corrente, creato al primo uso. Il k-esimo thread che lo
+// chiede usa streamSeed(seme, k); setThreadSeed vale per i thread che non lo
+// hanno ancora usato
+inline void setThreadSeed(std::uint64_t seed) {
+  detail::threadSeedBase() = seed;
+  detail::threadCounter() = 0;
+}
+inline UniformStream& threadUniformStream() {
+  thread_local UniformStream stream(streamSeed(
+      detail::threadSeedBase().load(), detail::threadCounter().fetch_add(1)));
+  return stream;
+}
+
+}  // namespace abc
+
+#endif
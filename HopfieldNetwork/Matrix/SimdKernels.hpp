@@ -0,0 +1,462 @@
+#ifndef HOPFIELDNEURALNETWORK_SIMDKERNELS_H
+#define HOPFIELDNEURALNETWORK_SIMDKERNELS_H
+
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define HOPFIELD_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// kernel vettoriali per i campi locali: righe di pesi double per uno stato di
+// interi +-1. La versione (SSE2, AVX2, AVX-512) si sceglie a runtime con
+// CPUID, quindi lo stesso eseguibile va bene su qualsiasi x86-64
+namespace abc::simd {
+
+enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+// tabella delle funzioni di una versione
+struct Kernels {
+  // sum_k w[k] * s[k]
+  double (*dot)(const double* w, const int* s, std::size_t n);
+  // y[k] += a * w[k]
+  void (*axpy)(double* y, const double* w, double a, std::size_t n);
+  // le due cose insieme, leggendo w una volta sola
+  double (*dotAxpy)(const double* w, const int* s, double* y, double a,
+                    std::size_t n);
+  // sum_k exp(x[k]) in float, con l'exp polinomiale di fastExp
+  float (*expSum)(const float* x, std::size_t n);
+};
+
+// exp in float alla Cephes: x = n ln2 + r, polinomio di grado 6 in r e 2^n
+// costruito negli esponenti. Errore relativo ~1e-7 su [-87, 88], fuori si
+// satura (quasi zero o ~1.6e38). Le versioni vettoriali fanno gli stessi
+// passi su 4, 8 o 16 lane
+namespace expf_constants {
+inline constexpr float kHi{88.3762626647949f};
+inline constexpr float kLo{-87.3365447505531f};
+inline constexpr float kLog2e{1.44269504088896341f};
+inline constexpr float kC1{0.693359375f};
+inline constexpr float kC2{-2.12194440e-4f};
+inline constexpr float kP0{1.9875691500e-4f};
+inline constexpr float kP1{1.3981999507e-3f};
+inline constexpr float kP2{8.3334519073e-3f};
+inline constexpr float kP3{4.1665795894e-2f};
+inline constexpr float kP4{1.6666665459e-1f};
+inline constexpr float kP5{5.0000001201e-1f};
+}  // namespace expf_constants
+
+inline float fastExp(float x) {
+  using namespace expf_constants;
+  x = std::fmin(std::fmax(x, kLo), kHi);
+  const float n{std::nearbyint(x * kLog2e)};
+  const float r{x - n * kC1 - n * kC2};
+  float p{kP0};
+  p = p * r + kP1;
+  p = p * r + kP2;
+  p = p * r + kP3;
+  p = p * r + kP4;
+  p = p * r + kP5;
+  p = p * r * r + r + 1.0f;
+  const auto bits = static_cast<std::uint32_t>(static_cast<int>(n) + 127)
+                    << 23;
+  return p * std::bit_cast<float>(bits);
+}
+
+namespace detail {
+
+inline double dotScalar(const double* w, const int* s, std::size_t n) {
+  double sum{0.0};
+  for (std::size_t k = 0; k < n; ++k) {
+    sum += w[k] * s[k];
+  }
+  return sum;
+}
+inline void axpyScalar(double* y, const double* w, double a, std::size_t n) {
+  for (std::size_t k = 0; k < n; ++k) {
+    y[k] += a * w[k];
+  }
+}
+inline double dotAxpyScalar(const double* w, const int* s, double* y,
+                            double a, std::size_t n) {
+  double sum{0.0};
+  for (std::size_t k = 0; k < n; ++k) {
+    sum += w[k] * s[k];
+    y[k] += a * w[k];
+  }
+  return sum;
+}
+inline float expSumScalar(const float* x, std::size_t n) {
+  float sum{0.0f};
+  for (std::size_t k = 0; k < n; ++k) {
+    sum += fastExp(x[k]);
+  }
+  return sum;
+}
+
+#ifdef HOPFIELD_SIMD_X86
+// gli stati sono letti come interi a 32 bit e convertiti in double nel
+// registro: nessuna copia dello stato in double
+inline __m128i loadInt2(const int* s) {
+  return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s));
+}
+
+__attribute__((target("sse2"))) inline double dotSSE2(const double* w,
+                                                      const int* s,
+                                                      std::size_t n) {
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  std::size_t k{0};
+  for (; k + 4 <= n; k += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(w + k),
+                                       _mm_cvtepi32_pd(loadInt2(s + k))));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(w + k + 2),
+                                       _mm_cvtepi32_pd(loadInt2(s + k + 2))));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  return lanes[0] + lanes[1] + dotScalar(w + k, s + k, n - k);
+}
+__attribute__((target("sse2"))) inline void axpySSE2(double* y,
+                                                     const double* w, double a,
+                                                     std::size_t n) {
+  const __m128d va = _mm_set1_pd(a);
+  std::size_t k{0};
+  for (; k + 2 <= n; k += 2) {
+    _mm_storeu_pd(y + k, _mm_add_pd(_mm_loadu_pd(y + k),
+                                    _mm_mul_pd(va, _mm_loadu_pd(w + k))));
+  }
+  axpyScalar(y + k, w + k, a, n - k);
+}
+__attribute__((target("sse2"))) inline double dotAxpySSE2(const double* w,
+                                                         const int* s,
+                                                         double* y, double a,
+                                                         std::size_t n) {
+  const __m128d va = _mm_set1_pd(a);
+  __m128d acc = _mm_setzero_pd();
+  std::size_t k{0};
+  for (; k + 2 <= n; k += 2) {
+    const __m128d vw = _mm_loadu_pd(w + k);
+    acc = _mm_add_pd(acc, _mm_mul_pd(vw, _mm_cvtepi32_pd(loadInt2(s + k))));
+    _mm_storeu_pd(y + k, _mm_add_pd(_mm_loadu_pd(y + k), _mm_mul_pd(va, vw)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  return lanes[0] + lanes[1] + dotAxpyScalar(w + k, s + k, y + k, a, n - k);
+}
+
+__attribute__((target("sse2"))) inline float expSumSSE2(const float* x,
+                                                       std::size_t n) {
+  using namespace expf_constants;
+  __m128 acc = _mm_setzero_ps();
+  std::size_t k{0};
+  for (; k + 4 <= n; k += 4) {
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(x + k), _mm_set1_ps(kLo)),
+                          _mm_set1_ps(kHi));
+    const __m128i ni = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(kLog2e)));
+    const __m128 nf = _mm_cvtepi32_ps(ni);
+    v = _mm_sub_ps(v, _mm_mul_ps(nf, _mm_set1_ps(kC1)));
+    v = _mm_sub_ps(v, _mm_mul_ps(nf, _mm_set1_ps(kC2)));
+    __m128 p = _mm_set1_ps(kP0);
+    p = _mm_add_ps(_mm_mul_ps(p, v), _mm_set1_ps(kP1));
+    p = _mm_add_ps(_mm_mul_ps(p, v), _mm_set1_ps(kP2));
+    p = _mm_add_ps(_mm_mul_ps(p, v), _mm_set1_ps(kP3));
+    p = _mm_add_ps(_mm_mul_ps(p, v), _mm_set1_ps(kP4));
+    p = _mm_add_ps(_mm_mul_ps(p, v), _mm_set1_ps(kP5));
+    p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, v), v), v),
+                   _mm_set1_ps(1.0f));
+    const __m128 scale = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_add_epi32(ni, _mm_set1_epi32(127)), 23));
+    acc = _mm_add_ps(acc, _mm_mul_ps(p, scale));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+         expSumScalar(x + k, n - k);
+}
+
+__attribute__((target("avx2,fma"))) inline double sumLanes(__m256d v) {
+  const __m128d half =
+      _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+__attribute__((target("avx2,fma"))) inline __m256d loadSpins4(const int* s) {
+  return _mm256_cvtepi32_pd(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+}
+__attribute__((target("avx2,fma"))) inline double dotAVX2(const double* w,
+                                                         const int* s,
+                                                         std::size_t n) {
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  std::size_t k{0};
+  for (; k + 8 <= n; k += 8) {
+    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(w + k), loadSpins4(s + k), acc0);
+    acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(w + k + 4), loadSpins4(s + k + 4),
+                           acc1);
+  }
+  for (; k + 4 <= n; k += 4) {
+    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(w + k), loadSpins4(s + k), acc0);
+  }
+  return sumLanes(_mm256_add_pd(acc0, acc1)) +
+         dotScalar(w + k, s + k, n - k);
+}
+__attribute__((target("avx2,fma"))) inline void axpyAVX2(double* y,
+                                                        const double* w,
+                                                        double a,
+                                                        std::size_t n) {
+  const __m256d va = _mm256_set1_pd(a);
+  std::size_t k{0};
+  for (; k + 4 <= n; k += 4) {
+    _mm256_storeu_pd(
+        y + k,
+        _mm256_fmadd_pd(va, _mm256_loadu_pd(w + k), _mm256_loadu_pd(y + k)));
+  }
+  axpyScalar(y + k, w + k, a, n - k);
+}
+__attribute__((target("avx2,fma"))) inline double dotAxpyAVX2(
+    const double* w, const int* s, double* y, double a, std::size_t n) {
+  const __m256d va = _mm256_set1_pd(a);
+  __m256d acc = _mm256_setzero_pd();
+  std::size_t k{0};
+  for (; k + 4 <= n; k += 4) {
+    const __m256d vw = _mm256_loadu_pd(w + k);
+    acc = _mm256_fmadd_pd(vw, loadSpins4(s + k), acc);
+    _mm256_storeu_pd(y + k,
+                     _mm256_fmadd_pd(va, vw, _mm256_loadu_pd(y + k)));
+  }
+  return sumLanes(acc) + dotAxpyScalar(w + k, s + k, y + k, a, n - k);
+}
+
+// 8 esponenziali per giro, senza maschere: gli ultimi n % 8 elementi passano
+// da expSumScalar
+__attribute__((target("avx2,fma"))) inline float expSumAVX2(const float* x,
+                                                           std::size_t n) {
+  using namespace expf_constants;
+  __m256 acc = _mm256_setzero_ps();
+  std::size_t k{0};
+  for (; k + 8 <= n; k += 8) {
+    __m256 v = _mm256_min_ps(
+        _mm256_max_ps(_mm256_loadu_ps(x + k), _mm256_set1_ps(kLo)),
+        _mm256_set1_ps(kHi));
+    const __m256i ni =
+        _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(kLog2e)));
+    const __m256 nf = _mm256_cvtepi32_ps(ni);
+    v = _mm256_fnmadd_ps(nf, _mm256_set1_ps(kC1), v);
+    v = _mm256_fnmadd_ps(nf, _mm256_set1_ps(kC2), v);
+    __m256 p = _mm256_set1_ps(kP0);
+    p = _mm256_fmadd_ps(p, v, _mm256_set1_ps(kP1));
+    p = _mm256_fmadd_ps(p, v, _mm256_set1_ps(kP2));
+    p = _mm256_fmadd_ps(p, v, _mm256_set1_ps(kP3));
+    p = _mm256_fmadd_ps(p, v, _mm256_set1_ps(kP4));
+    p = _mm256_fmadd_ps(p, v, _mm256_set1_ps(kP5));
+    p = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(p, v), v, v),
+                      _mm256_set1_ps(1.0f));
+    const __m256 scale = _mm256_castsi256_ps(
+        _mm256_slli_epi32(_mm256_add_epi32(ni, _mm256_set1_epi32(127)), 23));
+    acc = _mm256_fmadd_ps(p, scale, acc);
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+  float sum{0.0f};
+  for (float lane : lanes) {
+    sum += lane;
+  }
+  return sum + expSumScalar(x + k, n - k);
+}
+
+// versioni "maskz" delle intrinsic: le altre partono da un registro
+// indefinito e GCC 12 segnala (a torto) un valore non inizializzato
+__attribute__((target("avx512f"))) inline __m512d loadSpins8(const int* s) {
+  return _mm512_maskz_cvtepi32_pd(
+      0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)));
+}
+__attribute__((target("avx512f"))) inline double sumLanes8(__m512d v) {
+  double lanes[8];
+  _mm512_storeu_pd(lanes, v);
+  return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) +
+         ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+__attribute__((target("avx512f"))) inline double dotAVX512(const double* w,
+                                                          const int* s,
+                                                          std::size_t n) {
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  std::size_t k{0};
+  for (; k + 16 <= n; k += 16) {
+    acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(w + k), loadSpins8(s + k), acc0);
+    acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(w + k + 8), loadSpins8(s + k + 8),
+                           acc1);
+  }
+  for (; k + 8 <= n; k += 8) {
+    acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(w + k), loadSpins8(s + k), acc0);
+  }
+  return sumLanes8(_mm512_add_pd(acc0, acc1)) +
+         dotScalar(w + k, s + k, n - k);
+}
+__attribute__((target("avx512f"))) inline void axpyAVX512(double* y,
+                                                          const double* w,
+                                                          double a,
+                                                          std::size_t n) {
+  const __m512d va = _mm512_set1_pd(a);
+  std::size_t k{0};
+  for (; k + 8 <= n; k += 8) {
+    _mm512_storeu_pd(
+        y + k,
+        _mm512_fmadd_pd(va, _mm512_loadu_pd(w + k), _mm512_loadu_pd(y + k)));
+  }
+  axpyScalar(y + k, w + k, a, n - k);
+}
+__attribute__((target("avx512f"))) inline double dotAxpyAVX512(
+    const double* w, const int* s, double* y, double a, std::size_t n) {
+  const __m512d va = _mm512_set1_pd(a);
+  __m512d acc = _mm512_setzero_pd();
+  std::size_t k{0};
+  for (; k + 8 <= n; k += 8) {
+    const __m512d vw = _mm512_loadu_pd(w + k);
+    acc = _mm512_fmadd_pd(vw, loadSpins8(s + k), acc);
+    _mm512_storeu_pd(y + k,
+                     _mm512_fmadd_pd(va, vw, _mm512_loadu_pd(y + k)));
+  }
+  return sumLanes8(acc) +
+         dotAxpyScalar(w + k, s + k, y + k, a, n - k);
+}
+
+// 16 esponenziali per giro con le versioni maskz a maschera piena; la coda
+// di n % 16 elementi passa da expSumScalar come in AVX2
+__attribute__((target("avx512f"))) inline float expSumAVX512(const float* x,
+                                                            std::size_t n) {
+  using namespace expf_constants;
+  const __mmask16 all{0xFFFF};  // maskz: vedi loadSpins8
+  __m512 acc = _mm512_setzero_ps();
+  std::size_t k{0};
+  for (; k + 16 <= n; k += 16) {
+    __m512 v = _mm512_maskz_min_ps(
+        all,
+        _mm512_maskz_max_ps(all, _mm512_loadu_ps(x + k), _mm512_set1_ps(kLo)),
+        _mm512_set1_ps(kHi));
+    const __m512i ni =
+        _mm512_maskz_cvtps_epi32(all, _mm512_mul_ps(v, _mm512_set1_ps(kLog2e)));
+    const __m512 nf = _mm512_maskz_cvtepi32_ps(all, ni);
+    v = _mm512_fnmadd_ps(nf, _mm512_set1_ps(kC1), v);
+    v = _mm512_fnmadd_ps(nf, _mm512_set1_ps(kC2), v);
+    __m512 p = _mm512_set1_ps(kP0);
+    p = _mm512_fmadd_ps(p, v, _mm512_set1_ps(kP1));
+    p = _mm512_fmadd_ps(p, v, _mm512_set1_ps(kP2));
+    p = _mm512_fmadd_ps(p, v, _mm512_set1_ps(kP3));
+    p = _mm512_fmadd_ps(p, v, _mm512_set1_ps(kP4));
+    p = _mm512_fmadd_ps(p, v, _mm512_set1_ps(kP5));
+    p = _mm512_add_ps(_mm512_fmadd_ps(_mm512_mul_ps(p, v), v, v),
+                      _mm512_set1_ps(1.0f));
+    const __m512 scale = _mm512_castsi512_ps(_mm512_maskz_slli_epi32(
+        all, _mm512_add_epi32(ni, _mm512_set1_epi32(127)), 23));
+    acc = _mm512_fmadd_ps(p, scale, acc);
+  }
+  float lanes[16];
+  _mm512_storeu_ps(lanes, acc);
+  float sum{0.0f};
+  for (float lane : lanes) {
+    sum += lane;
+  }
+  return sum + expSumScalar(x + k, n - k);
+}
+#endif
+
+inline const Kernels* table(Isa isa) {
+  static const Kernels scalar{dotScalar, axpyScalar, dotAxpyScalar,
+                              expSumScalar};
+#ifdef HOPFIELD_SIMD_X86
+  static const Kernels sse2{dotSSE2, axpySSE2, dotAxpySSE2, expSumSSE2};
+  static const Kernels avx2{dotAVX2, axpyAVX2, dotAxpyAVX2, expSumAVX2};
+  static const Kernels avx512{dotAVX512, axpyAVX512, dotAxpyAVX512,
+                              expSumAVX512};
+  switch (isa) {
+    case Isa::SSE2:
+      return &sse2;
+    case Isa::AVX2:
+      return &avx2;
+    case Isa::AVX512:
+      return &avx512;
+    case Isa::Scalar:
+      break;
+  }
+#else
+  (void)isa;
+#endif
+  return &scalar;
+}
+
+}  // namespace detail
+
+// la CPU (e il sistema operativo) supportano le istruzioni di questa versione?
+inline bool isSupported(Isa isa) {
+  switch (isa) {
+    case Isa::Scalar:
+      return true;
+#ifdef HOPFIELD_SIMD_X86
+    case Isa::SSE2:
+      return __builtin_cpu_supports("sse2");
+    case Isa::AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case Isa::AVX512:
+      return __builtin_cpu_supports("avx512f");
+#else
+    default:
+      return false;
+#endif
+  }
+  return false;
+}
+
+// la versione migliore disponibile su questa macchina
+inline Isa bestIsa() {
+  for (Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE2}) {
+    if (isSupported(isa)) {
+      return isa;
+    }
+  }
+  return Isa::Scalar;
+}
+
+inline const char* isaName(Isa isa) {
+  switch (isa) {
+    case Isa::SSE2:
+      return "SSE2";
+    case Isa::AVX2:
+      return "AVX2";
+    case Isa::AVX512:
+      return "AVX-512";
+    case Isa::Scalar:
+      break;
+  }
+  return "scalar";
+}
+
+namespace detail {
+inline std::atomic<Isa>& activeSlot() {
+  static std::atomic<Isa> active{bestIsa()};
+  return active;
+}
+}  // namespace detail
+
+inline Isa activeIsa() { return detail::activeSlot().load(); }
+// forza una versione (test e benchmark); false se la CPU non la supporta
+inline bool setActiveIsa(Isa isa) {
+  if (!isSupported(isa)) {
+    return false;
+  }
+  detail::activeSlot().store(isa);
+  return true;
+}
+
+inline const Kernels& kernels(Isa isa) { return *detail::table(isa); }
+inline const Kernels& kernels() { return kernels(activeIsa()); }
+
+}  // namespace abc::simd
+
+#endif
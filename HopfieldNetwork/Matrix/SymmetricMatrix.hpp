@@ -0,0 +1,515 @@
+#ifndef HOPFIELDNEURALNETWORK_SYMMETRICMATRIX_H
+#define HOPFIELDNEURALNETWORK_SYMMETRICMATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MatrixStorage.hpp"
+#include "Parallel.hpp"
+#include "SimdKernels.hpp"
+
+namespace abc {
+
+// matrice quadrata simmetrica con diagonale nulla (come i pesi di Hebb):
+// si salva solo il triangolo superiore stretto, riga per riga. La riga i
+// contiene gli elementi (i, i+1) ... (i, n-1), quindi n * (n - 1) / 2 valori
+template <class T>
+class SymmetricMatrix {
+ private:
+  MatrixStorage<T> storage_;
+  std::size_t dim_{0};
+  bool fixedSize_{false};
+
+  static std::size_t packedSize(std::size_t n) {
+    return n == 0 ? 0 : n * (n - 1) / 2;
+  }
+  std::size_t rowOffset(std::size_t i) const {
+    return i * (2 * dim_ - i - 1) / 2;
+  }
+  void checkEmptiness() const  // class invariant
+  {
+    if (dim_ == 0) {
+      throw std::runtime_error("Matrix is empty!");
+    }
+  }
+  void reset(std::size_t n) {
+    dim_ = n;
+    storage_ = MatrixStorage<T>(packedSize(n), T{});
+  }
+  // per i pesi double le righe passano dai kernel vettoriali (scelti a
+  // runtime), per gli altri tipi si usano i loop scalari
+  static T rowDot(std::span<const T> row, const int* state) {
+    if constexpr (std::is_same_v<T, double>) {
+      return simd::kernels().dot(row.data(), state, row.size());
+    } else {
+      T sum{};
+      for (std::size_t k = 0; k < row.size(); ++k) {
+        sum += row[k] * state[k];
+      }
+      return sum;
+    }
+  }
+  static T rowDotAxpy(std::span<const T> row, const int* state, T* y, T a) {
+    if constexpr (std::is_same_v<T, double>) {
+      return simd::kernels().dotAxpy(row.data(), state, y, a, row.size());
+    } else {
+      T sum{};
+      for (std::size_t k = 0; k < row.size(); ++k) {
+        sum += row[k] * state[k];
+        y[k] += row[k] * a;
+      }
+      return sum;
+    }
+  }
+  auto packedElementCount() const {
+    return [this](const MatrixFileHeader& header) {
+      if (header.rows != header.cols) {
+        throw std::runtime_error("Matrix dimensions do not match!");
+      }
+      if (fixedSize_ && header.rows != dim_) {
+        throw std::runtime_error(
+            "Cannot load the file: matrix has a fixed size!");
+      }
+      if (header.rows == 0) {
+        return std::size_t{0};
+      }
+      return checkedProduct(header.rows, header.rows - 1) / 2;
+    };
+  }
+  // multiplyBatch ristretto alle colonne [qBegin, qEnd) degli stati
+  void multiplyBatchColumns(std::span<const std::int8_t> states,
+                            std::size_t b, std::span<T> fields,
+                            std::size_t qBegin, std::size_t qEnd) const {
+    constexpr std::size_t rowTile{32};
+    constexpr std::size_t colTile{256};
+    for (std::size_t iBegin = 0; iBegin < dim_; iBegin += rowTile) {
+      const std::size_t iEnd{std::min(iBegin + rowTile, dim_)};
+      for (std::size_t jb = iBegin + 1; jb < dim_; jb += colTile) {
+        const std::size_t jEnd{std::min(jb + colTile, dim_)};
+        for (std::size_t i = iBegin; i < iEnd && i + 1 < jEnd; ++i) {
+          const T* row = storage_.data() + rowOffset(i);
+          const std::int8_t* si = states.data() + i * b;
+          T* hi = fields.data() + i * b;
+          for (std::size_t j = std::max(jb, i + 1); j < jEnd; ++j) {
+            const T w{row[j - i - 1]};
+            const std::int8_t* sj = states.data() + j * b;
+            T* hj = fields.data() + j * b;
+            for (std::size_t q = qBegin; q < qEnd; ++q) {
+              hi[q] += w * static_cast<T>(sj[q]);
+              hj[q] += w * static_cast<T>(si[q]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+ public:
+  SymmetricMatrix() {}
+  explicit SymmetricMatrix(std::size_t dimension)
+      : storage_(packedSize(dimension), T{}), dim_{dimension} {}
+
+  // setter
+  void setElement(std::size_t i, std::size_t j, T value) {
+    checkEmptiness();
+    if (i >= dim_ || j >= dim_) {
+      throw std::runtime_error(
+          "Point is not inside the matrix, please provide valid coordinates!");
+    }
+    if (i == j) {
+      if (value != T{}) {
+        throw std::runtime_error(
+            "The diagonal of a symmetric packed matrix is always zero!");
+      }
+      return;
+    }
+    (*this)(std::min(i, j), std::max(i, j)) = value;
+  }
+  void setFixedSize(bool a) {
+    checkEmptiness();
+    fixedSize_ = a;
+  }
+
+  // getter
+  T getElement(std::size_t i, std::size_t j) const {
+    if (i >= dim_ || j >= dim_) {
+      throw std::runtime_error("Indices are overcoming matrix dimension");
+    }
+    if (i == j) {
+      return T{};
+    }
+    return (*this)(std::min(i, j), std::max(i, j));
+  }
+  std::size_t size() const { return dim_; }
+  std::size_t cols() const { return dim_; }
+  std::size_t packedSize() const { return storage_.size(); }
+  bool isMapped() const { return storage_.isMapped(); }
+  // copia i pesi mappati in un buffer proprio, prima di modificarli
+  void detach() { storage_.detach(); }
+
+  // accesso senza controlli, solo per i < j
+  T& operator()(std::size_t i, std::size_t j) {
+    return storage_.data()[rowOffset(i) + (j - i - 1)];
+  }
+  const T& operator()(std::size_t i, std::size_t j) const {
+    return storage_.data()[rowOffset(i) + (j - i - 1)];
+  }
+  // elementi (i, i+1) ... (i, n-1), contigui in memoria
+  std::span<T> upperRow(std::size_t i) {
+    return std::span<T>(storage_.data() + rowOffset(i), dim_ - i - 1);
+  }
+  std::span<const T> upperRow(std::size_t i) const {
+    return std::span<const T>(storage_.data() + rowOffset(i), dim_ - i - 1);
+  }
+
+  // kernel
+  // field = W * state. Ogni riga impacchettata viene letta una sola volta e
+  // contribuisce sia a field[i] (prodotto scalare) sia a field[j > i] (axpy)
+  void multiply(std::span<const int> state, std::span<T> field) const {
+    std::fill(field.begin(), field.end(), T{});
+    for (std::size_t i = 0; i < dim_; ++i) {
+      field[i] += rowDotAxpy(upperRow(i), state.data() + i + 1,
+                             field.data() + i + 1, static_cast<T>(state[i]));
+    }
+  }
+  // come multiply, ma scrive anche sign[i] = (field[i] > 0 ? 1 : -1). Dopo la
+  // riga i il campo field[i] e' completo (le righe j < i lo hanno gia'
+  // aggiornato), quindi il segno esce nella stessa passata
+  void multiplySign(std::span<const int> state, std::span<T> field,
+                    std::span<int> sign) const {
+    std::fill(field.begin(), field.end(), T{});
+    for (std::size_t i = 0; i < dim_; ++i) {
+      field[i] += rowDotAxpy(upperRow(i), state.data() + i + 1,
+                             field.data() + i + 1, static_cast<T>(state[i]));
+      sign[i] = field[i] > T{} ? 1 : -1;
+    }
+  }
+  // buffer della versione parallela di multiplySign: i confini dei gruppi di
+  // righe e un accumulatore per thread. Si ricalcolano solo se cambiano la
+  // dimensione o il numero di thread, altrimenti si riusano fra le chiamate
+  struct SignWorkspace {
+    std::size_t dim{0};
+    unsigned int workers{0};
+    std::vector<std::size_t> bounds;
+    std::vector<std::vector<T>> partial;
+  };
+  // versione parallela di multiplySign. Le righe sono divise in gruppi con lo
+  // stesso numero di elementi; ogni thread accumula i contributi dei suoi
+  // gruppi (prodotto scalare + axpy) in un buffer proprio, poi i buffer sono
+  // sommati a blocchi di colonne e il segno esce insieme alla somma
+  void multiplySign(std::span<const int> state, std::span<T> field,
+                    std::span<int> sign, ThreadPool& pool,
+                    SignWorkspace& work) const {
+    const unsigned int workers{pool.size()};
+    if (workers == 1 || dim_ < 2) {
+      multiplySign(state, field, sign);
+      return;
+    }
+    if (work.dim != dim_ || work.workers != workers) {
+      const std::size_t nGroups{std::min<std::size_t>(4 * workers, dim_)};
+      work.bounds.assign(1, 0);
+      for (std::size_t i = 0; i < dim_ && work.bounds.size() < nGroups; ++i) {
+        if (rowOffset(i) * nGroups >= work.bounds.size() * packedSize()) {
+          if (i > work.bounds.back()) {
+            work.bounds.push_back(i);
+          }
+        }
+      }
+      work.bounds.push_back(dim_);
+      work.partial.assign(workers, std::vector<T>(dim_, T{}));
+      work.dim = dim_;
+      work.workers = workers;
+    } else {
+      for (auto& buffer : work.partial) {
+        std::fill(buffer.begin(), buffer.end(), T{});
+      }
+    }
+
+    const auto& bounds = work.bounds;
+    auto& partial = work.partial;
+    pool.run(bounds.size() - 1, [&](std::size_t g, unsigned int w) {
+      T* buffer = partial[w].data();
+      for (std::size_t i = bounds[g]; i < bounds[g + 1]; ++i) {
+        buffer[i] += rowDotAxpy(upperRow(i), state.data() + i + 1,
+                                buffer + i + 1, static_cast<T>(state[i]));
+      }
+    });
+
+    constexpr std::size_t colBlock{4096};
+    pool.run((dim_ + colBlock - 1) / colBlock,
+             [&](std::size_t b, unsigned int) {
+               const std::size_t end{std::min(dim_, (b + 1) * colBlock)};
+               for (std::size_t j = b * colBlock; j < end; ++j) {
+                 T sum{};
+                 for (const auto& buffer : partial) {
+                   sum += buffer[j];
+                 }
+                 field[j] = sum;
+                 sign[j] = sum > T{} ? 1 : -1;
+               }
+             });
+  }
+  // come sopra, con buffer usati per una sola chiamata
+  void multiplySign(std::span<const int> state, std::span<T> field,
+                    std::span<int> sign, ThreadPool& pool) const {
+    SignWorkspace work;
+    multiplySign(state, field, sign, pool, work);
+  }
+  // campo locale di un singolo elemento: la parte j < i e' la colonna i
+  // (strided), la parte j > i e' la riga impacchettata
+  T field(std::size_t i, std::span<const int> state) const {
+    T sum{};
+    for (std::size_t j = 0; j < i; ++j) {
+      sum += (*this)(j, i) * state[j];
+    }
+    return sum + rowDot(upperRow(i), state.data() + i + 1);
+  }
+  // field[j] += a * W(i, j) per ogni j > i: la riga impacchettata i
+  void addRowAbove(std::size_t i, T a, std::span<T> field) const {
+    const auto row = upperRow(i);
+    T* fieldTail = field.data() + i + 1;
+    if constexpr (std::is_same_v<T, double>) {
+      simd::kernels().axpy(fieldTail, row.data(), a, row.size());
+    } else {
+      for (std::size_t k = 0; k < row.size(); ++k) {
+        fieldTail[k] += row[k] * a;
+      }
+    }
+  }
+  // field[j] += sum_{c : columns[c] > j} W(j, columns[c]) * deltas[c], con
+  // columns ordinato: e' la parte "sopra la diagonale" delle colonne indicate,
+  // letta riga per riga invece che scorrendo le colonne (strided)
+  void addColumnsAbove(std::span<const std::size_t> columns,
+                       std::span<const T> deltas, std::span<T> field) const {
+    std::size_t first{0};
+    for (std::size_t j = 0; j < dim_; ++j) {
+      while (first < columns.size() && columns[first] <= j) {
+        ++first;
+      }
+      if (first == columns.size()) {
+        break;
+      }
+      const T* row = storage_.data() + rowOffset(j);
+      T sum{};
+      for (std::size_t c = first; c < columns.size(); ++c) {
+        sum += row[columns[c] - j - 1] * deltas[c];
+      }
+      field[j] += sum;
+    }
+  }
+  // kernel per piu' stati insieme (recupero a blocchi): states e fields sono
+  // matrici dim x b row-major, la riga i contiene il neurone i di tutti gli
+  // stati. Ogni peso viene letto una volta sola e usato per tutti gli stati.
+  // Gli stati restano a 8 bit fino alla moltiplicazione
+
+  // fields = W * states, a blocchi come rankUpdate: le righe di states e
+  // fields di un blocco di colonne restano in cache per tutte le righe di W
+  // del blocco
+  void multiplyBatch(std::span<const std::int8_t> states, std::size_t b,
+                     std::span<T> fields) const {
+    std::fill(fields.begin(), fields.end(), T{});
+    multiplyBatchColumns(states, b, fields, 0, b);
+  }
+  // versione parallela: gli stati sono divisi in gruppi di colonne, ognuno
+  // scrive solo le sue colonne di fields e i thread non si sovrappongono
+  void multiplyBatch(std::span<const std::int8_t> states, std::size_t b,
+                     std::span<T> fields, ThreadPool& pool) const {
+    std::fill(fields.begin(), fields.end(), T{});
+    const std::size_t chunk{(b + pool.size() - 1) / pool.size()};
+    if (chunk == 0) {
+      return;
+    }
+    pool.run((b + chunk - 1) / chunk, [&](std::size_t c, unsigned int) {
+      multiplyBatchColumns(states, b, fields, c * chunk,
+                           std::min(b, (c + 1) * chunk));
+    });
+  }
+  // fields[j][q] += W(i, j) * deltas[q] per ogni j > i
+  void addRowAboveBatch(std::size_t i, std::span<const T> deltas,
+                        std::span<T> fields) const {
+    const std::size_t b{deltas.size()};
+    const auto row = upperRow(i);
+    for (std::size_t k = 0; k < row.size(); ++k) {
+      T* hj = fields.data() + (i + 1 + k) * b;
+      for (std::size_t q = 0; q < b; ++q) {
+        hj[q] += row[k] * deltas[q];
+      }
+    }
+  }
+  // come addColumnsAbove, con deltas matrice columns.size() x b
+  void addColumnsAboveBatch(std::span<const std::size_t> columns,
+                            std::span<const T> deltas, std::size_t b,
+                            std::span<T> fields) const {
+    std::size_t first{0};
+    for (std::size_t j = 0; j < dim_; ++j) {
+      while (first < columns.size() && columns[first] <= j) {
+        ++first;
+      }
+      if (first == columns.size()) {
+        break;
+      }
+      const T* row = storage_.data() + rowOffset(j);
+      T* hj = fields.data() + j * b;
+      for (std::size_t c = first; c < columns.size(); ++c) {
+        const T w{row[columns[c] - j - 1]};
+        const T* dc = deltas.data() + c * b;
+        for (std::size_t q = 0; q < b; ++q) {
+          hj[q] += w * dc[q];
+        }
+      }
+    }
+  }
+
+  // sum_{i<j} W_ij s_i s_j = 0.5 * s^T W s, una sola passata sul triangolo
+  T quadraticForm(std::span<const int> state) const {
+    T total{};
+    for (std::size_t i = 0; i + 1 < dim_; ++i) {
+      total += rowDot(upperRow(i), state.data() + i + 1) * state[i];
+    }
+    return total;
+  }
+
+  // W += scale * X X^T sul triangolo superiore, con X matrice dim x k
+  // row-major (la riga i e' il neurone i in tutti i k pattern). Il lavoro e'
+  // diviso in blocchi di righe distribuiti fra i thread; dentro ogni blocco le
+  // colonne sono scorse a blocchi, cosi' le righe di X restano in cache
+  void rankUpdate(std::span<const std::int8_t> stacked, std::size_t k,
+                  T scale, unsigned int nThreads = 0) {
+    if (stacked.size() != dim_ * k) {
+      throw std::runtime_error(
+          "Stacked patterns and matrix sizes do not match!");
+    }
+    if (k == 0 || dim_ < 2) {
+      return;
+    }
+    storage_.detach();
+    constexpr std::size_t rowTile{32};
+    constexpr std::size_t colTile{256};
+    const std::size_t nTiles{(dim_ + rowTile - 1) / rowTile};
+
+    parallelFor(
+        nTiles,
+        [&](std::size_t tile) {
+          const std::size_t iBegin{tile * rowTile};
+          const std::size_t iEnd{std::min(iBegin + rowTile, dim_)};
+          for (std::size_t jb = iBegin + 1; jb < dim_; jb += colTile) {
+            const std::size_t jEnd{std::min(jb + colTile, dim_)};
+            for (std::size_t i = iBegin; i < iEnd && i + 1 < jEnd; ++i) {
+              const std::int8_t* xi = stacked.data() + i * k;
+              T* row = storage_.data() + rowOffset(i);
+              for (std::size_t j = std::max(jb, i + 1); j < jEnd; ++j) {
+                const std::int8_t* xj = stacked.data() + j * k;
+                int overlap{0};
+                for (std::size_t p = 0; p < k; ++p) {
+                  overlap += xi[p] * xj[p];
+                }
+                row[j - i - 1] += scale * overlap;
+              }
+            }
+          }
+        },
+        nThreads);
+  }
+
+  // i file di testo contengono la matrice densa (export e compatibilita')
+  bool saveOnFile(const std::string& filepath) const {
+    checkEmptiness();
+    std::ofstream file(filepath);
+    if (!file.is_open()) {
+      throw std::runtime_error("Cannot create the file!");
+    }
+    for (std::size_t i = 0; i < dim_; ++i) {
+      for (std::size_t j = 0; j < dim_; ++j) {
+        file << getElement(i, j) << " ";
+      }
+      file << "\n";
+    }
+    file.close();
+    return true;
+  }
+  // legge una matrice densa riga per riga e ne tiene il triangolo superiore.
+  // Il file deve essere quadrato: senza dimensione fissa la prima riga la
+  // decide, con dimensione fissa deve coincidere con quella della matrice
+  void loadMatrixFromFile(const std::string& filepath) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+      throw std::runtime_error("Cannot open the file!");
+    }
+    std::string l;
+    std::size_t i{0};
+    std::size_t rows{0};
+    std::vector<T> row;
+    T num;
+
+    while (std::getline(file, l)) {
+      row.clear();
+      std::istringstream iss(l);
+      while (iss >> num) {
+        row.push_back(num);
+      }
+      if (!row.empty()) {
+        if (rows == 0 && !fixedSize_) {
+          reset(row.size());
+        }
+        if (i >= dim_) {
+          throw std::runtime_error(
+              fixedSize_ ? "Cannot append new rows: matrix has a fixed size!"
+                         : "Matrix dimensions do not match!");
+        }
+        if (row.size() > dim_) {
+          throw std::runtime_error(
+              "New line is too long, please check its size and retry");
+        }
+        if (row.size() < dim_) {
+          throw std::runtime_error(
+              "New line is too short, please check its size and retry");
+        }
+        for (std::size_t j = i + 1; j < row.size(); ++j) {
+          (*this)(i, j) = row[j];
+        }
+        ++rows;
+      }
+      ++i;
+    }
+    if (rows != 0 && rows != dim_) {
+      throw std::runtime_error("Matrix dimensions do not match!");
+    }
+    file.close();
+  }
+
+  bool saveOnBinaryFile(const std::string& filepath) const {
+    checkEmptiness();
+    storage_.save(filepath, MatrixLayout::SymmetricPacked, dim_, dim_);
+    return true;
+  }
+  void loadMatrixFromBinaryFile(const std::string& filepath,
+                                bool verifyChecksum = true) {
+    const auto header{storage_.load(filepath, MatrixLayout::SymmetricPacked,
+                                    verifyChecksum, packedElementCount())};
+    dim_ = header.rows;
+  }
+  // come in Matrix: il checksum si salta solo se richiesto
+  void mapBinaryFile(const std::string& filepath,
+                     bool verifyChecksum = true) {
+    const auto header{storage_.map(filepath, MatrixLayout::SymmetricPacked,
+                                   verifyChecksum, packedElementCount())};
+    dim_ = header.rows;
+  }
+
+  size_t NumberOfElement() const {
+    checkEmptiness();
+    return dim_ * dim_;
+  }
+};
+
+}  // namespace abc
+
+#endif
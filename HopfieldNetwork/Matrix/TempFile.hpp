@@ -0,0 +1,38 @@
+#ifndef HOPFIELDNEURALNETWORK_TEMPFILE_H
+#define HOPFIELDNEURALNETWORK_TEMPFILE_H
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+namespace abc {
+
+// percorso di un file (o di una cartella) di prova nella cartella temporanea
+// di sistema, cancellato dal distruttore: i test non scrivono nei sorgenti.
+// Il pid nel nome separa gli eseguibili di test lanciati insieme
+class TempFile {
+ private:
+  std::filesystem::path path_;
+
+ public:
+  explicit TempFile(const std::string& name)
+      : path_{std::filesystem::temp_directory_path() /
+              ("hopfield_" + std::to_string(::getpid()) + "_" + name)} {
+    std::error_code error;
+    std::filesystem::remove_all(path_, error);
+  }
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+  ~TempFile() {
+    std::error_code error;
+    std::filesystem::remove_all(path_, error);
+  }
+
+  std::string path() const { return path_.string(); }
+};
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,131 @@
+// microbenchmark dei kernel dei campi locali: confronta la versione scalare
+// con quelle vettoriali supportate dalla CPU su una matrice di pesi N x N.
+// Misura anche l'exp in float delle energie Modern e il costo dei test di
+// accettazione dell'annealing
+// uso: KernelBench [N] [ripetizioni]
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Random.hpp"
+#include "SimdKernels.hpp"
+#include "SymmetricMatrix.hpp"
+
+namespace {
+template <class Body>
+double millisecondsPerRun(int repetitions, Body body) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; ++r) {
+    body();
+  }
+  const std::chrono::duration<double, std::milli> elapsed{
+      std::chrono::steady_clock::now() - start};
+  return elapsed.count() / repetitions;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const std::size_t n{argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096};
+  const int repetitions{argc > 2 ? std::atoi(argv[2]) : 20};
+  if (n < 2 || repetitions < 1) {
+    std::cerr << "Usage: KernelBench [N >= 2] [repetitions >= 1]\n";
+    return 1;
+  }
+
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> weight(-1.0, 1.0);
+  abc::SymmetricMatrix<double> w(n);
+  for (std::size_t i = 0; i + 1 < n; ++i) {
+    for (double& value : w.upperRow(i)) {
+      value = weight(gen);
+    }
+  }
+  std::vector<int> state(n);
+  for (int& s : state) {
+    s = gen() % 2 == 0 ? 1 : -1;
+  }
+  std::vector<double> field(n);
+  std::vector<int> sign(n);
+
+  std::cout << "N = " << n << ", " << repetitions << " runs, best ISA: "
+            << abc::simd::isaName(abc::simd::bestIsa()) << "\n";
+  std::cout << std::left << std::setw(10) << "ISA" << std::setw(14)
+            << "W*s [ms]" << std::setw(14) << "sign [ms]" << std::setw(14)
+            << "GB/s" << "speedup\n";
+
+  double scalarTime{0.0};
+  for (auto isa : {abc::simd::Isa::Scalar, abc::simd::Isa::SSE2,
+                   abc::simd::Isa::AVX2, abc::simd::Isa::AVX512}) {
+    if (!abc::simd::setActiveIsa(isa)) {
+      continue;
+    }
+    const double multiplyTime{millisecondsPerRun(
+        repetitions, [&]() { w.multiply(state, field); })};
+    const double signTime{millisecondsPerRun(
+        repetitions, [&]() { w.multiplySign(state, field, sign); })};
+    if (isa == abc::simd::Isa::Scalar) {
+      scalarTime = multiplyTime;
+    }
+    // ogni passata legge il triangolo una volta sola
+    const double gigabytes{static_cast<double>(w.packedSize()) *
+                           sizeof(double) / 1e9};
+    std::cout << std::setw(10) << abc::simd::isaName(isa) << std::setw(14)
+              << multiplyTime << std::setw(14) << signTime << std::setw(14)
+              << gigabytes / (multiplyTime / 1e3) << scalarTime / multiplyTime
+              << "x\n";
+  }
+  abc::simd::setActiveIsa(abc::simd::bestIsa());
+
+  // termini exp delle energie Modern: std::exp in double contro l'exp
+  // polinomiale in float
+  std::vector<double> argsDouble(n);
+  std::vector<float> argsFloat(n);
+  for (std::size_t k = 0; k < n; ++k) {
+    argsDouble[k] = -weight(gen) * 20.0;
+    argsFloat[k] = static_cast<float>(argsDouble[k]);
+  }
+  double expSink{0.0};
+  const double expDoubleTime{millisecondsPerRun(repetitions * 100, [&]() {
+    double sum{0.0};
+    for (double x : argsDouble) {
+      sum += std::exp(x);
+    }
+    expSink += sum;
+  })};
+  const double expFloatTime{millisecondsPerRun(repetitions * 100, [&]() {
+    expSink += abc::simd::kernels().expSum(argsFloat.data(), n);
+  })};
+  std::cout << "\n" << n << " exp terms: std::exp " << expDoubleTime * 1e3
+            << " us, float " << abc::simd::isaName(abc::simd::activeIsa())
+            << " " << expFloatTime * 1e3 << " us ("
+            << expDoubleTime / expFloatTime << "x)"
+            << (expSink < 0.0 ? " " : "") << "\n";
+
+  // un test di accettazione per neurone e per sweep: prima si creavano
+  // random_device e mt19937 a ogni test
+  const int draws{100000};
+  double sink{0.0};
+  const double perCallTime{millisecondsPerRun(1, [&]() {
+    for (int d = 0; d < draws; ++d) {
+      std::random_device rd;
+      std::mt19937 mt(rd());
+      std::uniform_real_distribution<> distrib(0.0, 1.0);
+      sink += distrib(mt);
+    }
+  })};
+  abc::UniformStream stream;
+  const double streamTime{millisecondsPerRun(1, [&]() {
+    for (int d = 0; d < draws; ++d) {
+      sink += stream();
+    }
+  })};
+  std::cout << "\n" << draws << " uniform draws: random_device + mt19937 "
+            << perCallTime << " ms, UniformStream " << streamTime << " ms ("
+            << perCallTime / streamTime << "x)" << (sink < 0.0 ? " " : "")
+            << "\n";
+  return 0;
+}
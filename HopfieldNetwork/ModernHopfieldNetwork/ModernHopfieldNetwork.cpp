@@ -1,12 +1,24 @@
 #include "ModernHopfieldNetwork.hpp"
 
 #include <cassert>
+#include <algorithm>
 #include <cmath>
+#include <functional>
 #include <iostream>
-#include <random>
+#include <limits>
 
 namespace abc {
 
+namespace {
+// x / T anche a temperatura nulla (inverseTemp = +inf): x = 0 resta 0 invece
+// di 0 * inf = NaN. A T = 0 il termine della memoria che fa da shift vale 1,
+// quelli sotto 0 e quelli sopra +inf: le energie confrontano gli overlap
+// massimi, come una discesa pura
+double scaled(double x, double inverseTemp) {
+  return x == 0.0 ? 0.0 : x * inverseTemp;
+}
+}  // namespace
+
 ModernHopfieldNetwork::ModernHopfieldNetwork() {}
 ModernHopfieldNetwork::ModernHopfieldNetwork(int dimension) {
   {
@@ -20,154 +32,653 @@ ModernHopfieldNetwork::ModernHopfieldNetwork(int dimension) {
 }
 
 void ModernHopfieldNetwork::learnPattern(const std::vector<int>& pattern) {
-  patternMatrix_.append(pattern);
-  dim_ = pattern.size();
+  // stessi controlli di Matrix::append
+  if (pattern.empty()) {
+    throw std::runtime_error("Your vector is empty!");
+  }
+  if (packedMemories_.size() == 0) {
+    // la prima memoria fissa la dimensione
+    dim_ = pattern.size();
+    memoryColumns_ = BitColumns(dim_);
+  } else if (pattern.size() != dim_) {
+    throw std::runtime_error("Vector and matrix sizes do not match!");
+  }
+  appendMemory(pattern);
+  rebuildMemoryIndex();
+}
+
+// a 1 bit per spin si perde tutto cio' che non e' +-1
+void ModernHopfieldNetwork::appendMemory(std::span<const int> pattern) {
+  if (std::any_of(pattern.begin(), pattern.end(),
+                  [](int v) { return v != 1 && v != -1; })) {
+    throw std::runtime_error("Patterns must contain only +1 and -1!");
+  }
+  const BitPattern packed(pattern);
+  packedMemories_.append(std::vector<std::uint64_t>(packed.words().begin(),
+                                                    packed.words().end()));
+  memoryColumns_.append(packed.words());
+  appendGramRow();
+}
+
+void ModernHopfieldNetwork::packMemories(const Matrix<int>& memories) {
+  packedMemories_ = Matrix<std::uint64_t>();
+  dim_ = memories.cols();
+  memoryColumns_ = BitColumns(dim_);
+  gram_.clear();
+  for (std::size_t mu = 0; mu < memories.size(); ++mu) {
+    appendMemory(memories.row(mu));
+  }
+  // memorie nuove, anche se tante quante prima
+  rebuildMemoryIndex();
+}
+
+// O(M * N / 64): un prodotto xor/popcount per ogni memoria precedente
+void ModernHopfieldNetwork::appendGramRow() {
+  const std::size_t mu{packedMemories_.size() - 1};
+  const auto memory = packedMemories_.row(mu);
+  for (std::size_t nu = 0; nu < mu; ++nu) {
+    gram_.push_back(bitDot(packedMemories_.row(nu), memory, dim_));
+  }
+}
+
+std::span<const std::uint64_t> ModernHopfieldNetwork::packedRows() const {
+  return std::span<const std::uint64_t>(
+      packedMemories_.data(), packedMemories_.size() * packedMemories_.cols());
+}
+
+// O(M log M) per sottostringa: con il recupero top-k attivo ogni
+// learnPattern ricostruisce l'indice, conviene chiamare setTopK dopo aver
+// imparato le memorie
+void ModernHopfieldNetwork::rebuildMemoryIndex() {
+  if (topK_ == 0 || packedMemories_.size() == 0) {
+    memoryIndex_ = MultiIndexHash();
+    return;
+  }
+  if (memoryIndex_.bits() != dim_) {
+    memoryIndex_ = MultiIndexHash(dim_);
+  }
+  memoryIndex_.build(packedRows());
 }
 
-void ModernHopfieldNetwork::save(const std::string& filepath) const {
-  patternMatrix_.saveOnFile(filepath);
+void ModernHopfieldNetwork::setTopK(std::size_t k) {
+  topK_ = k;
+  rebuildMemoryIndex();
+}
+
+void ModernHopfieldNetwork::save(const std::string& filepath,
+                                 FileFormat format) const {
+  // i file restano in int, come prima dell'impacchettamento
+  const Matrix<int> memories{getMatrix()};
+  if (format == FileFormat::Binary) {
+    memories.saveOnBinaryFile(filepath);
+  } else {
+    memories.saveOnFile(filepath);
+  }
 }
 
 void ModernHopfieldNetwork::loadMemory(const std::string& filepath) {
-  patternMatrix_.loadMatrixFromFile(filepath);
-  dim_ = patternMatrix_.getMatrix()[0].size();
+  // i file binari vengono mappati in memoria, senza parsing: la mappa serve
+  // solo finche' le memorie non sono impacchettate
+  Matrix<int> memories;
+  if (isBinaryMatrixFile(filepath)) {
+    memories.mapBinaryFile(filepath);
+  } else {
+    memories.loadMatrixFromFile(filepath);
+  }
+  packMemories(memories);
 }
 
-const Matrix<int>& ModernHopfieldNetwork::getMatrix() const {
-  return patternMatrix_;
+Matrix<int> ModernHopfieldNetwork::getMatrix() const {
+  Matrix<int> memories;
+  for (std::size_t mu = 0; mu < packedMemories_.size(); ++mu) {
+    memories.append(BitPattern(dim_, packedMemories_.row(mu)).toVector());
+  }
+  return memories;
 }
 
 double ModernHopfieldNetwork::totalSystemEnergy() const {
   double sum{0.0};
+  const double scale{1.0 / std::sqrt(dim_)};
+  for (const int overlap : gram_) {
+    sum -= std::exp(overlap * scale);
+  }
+  return sum;
+}
 
-  for (std::size_t i = 0; i < patternMatrix_.size(); ++i) {
-    for (std::size_t j = i + 1; j < patternMatrix_.size(); ++j) {
-      const auto& v1 = patternMatrix_.getMatrix()[i];
-      const auto& v2 = patternMatrix_.getMatrix()[j];
-      assert(v1.size() == v2.size());
+std::span<const int> ModernHopfieldNetwork::memoryOverlaps(
+    std::size_t mu) const {
+  if (mu >= packedMemories_.size()) {
+    throw std::runtime_error("Index is out of bounds!");
+  }
+  return std::span<const int>(gram_).subspan(mu * (mu - 1) / 2, mu);
+}
 
-      double dot = std::inner_product(v1.begin(), v1.end(), v2.begin(), 0.0);
-      sum -= std::exp(dot / std::sqrt(dim_));
+std::vector<std::pair<std::size_t, std::size_t>>
+ModernHopfieldNetwork::nearDuplicates(int minOverlap) const {
+  std::vector<std::pair<std::size_t, std::size_t>> pairs;
+  std::size_t k{0};
+  for (std::size_t mu = 1; mu < packedMemories_.size(); ++mu) {
+    for (std::size_t nu = 0; nu < mu; ++nu, ++k) {
+      if (gram_[k] >= minOverlap) {
+        pairs.emplace_back(nu, mu);
+      }
     }
   }
-
-  return sum;
+  return pairs;
 }
 
 void ModernHopfieldNetwork::setTemp0(double energy) {
-  temp_0_ = std::abs(energy * 4.5);
+  cooling_.setT0(std::abs(energy * 4.5));
 }
 
-double ModernHopfieldNetwork::dot(const std::vector<int>& a,
-                                  const std::vector<int>& b) const {
+double ModernHopfieldNetwork::dot(std::span<const std::uint64_t> memory,
+                                  std::span<const int> state) const {
   double sum = 0;
-  for (size_t i = 0; i < dim_; ++i) sum += a[i] * b[i];
+  for (size_t i = 0; i < dim_; ++i) sum += bitSpin(memory, i) * state[i];
   return sum;
 }
 
-bool ModernHopfieldNetwork::restorePattern(std::vector<int>& input) {
+double ModernHopfieldNetwork::dot(const BitPattern& a,
+                                  const BitPattern& b) const {
+  return abc::dot(a, b);
+}
+
+void ModernHopfieldNetwork::computeOverlaps(const std::vector<int>& state,
+                                            double inverseTemp,
+                                            RecallWorkspace& work) const {
+  work.packedState = BitPattern(state);
+  selectMemories(inverseTemp, work);
+  work.expTerms.resize(work.active.size());
+  updateExpTerms(inverseTemp, work);
+}
+
+void ModernHopfieldNetwork::selectMemories(double inverseTemp,
+                                           RecallWorkspace& work) const {
+  const std::size_t nMemories{packedMemories_.size()};
+  work.logNeglected = -std::numeric_limits<double>::infinity();
+  std::size_t threshold{0};
+  if (topK_ > 0 && nMemories > topK_) {
+    threshold = memoryIndex_.candidates(packedRows(), work.packedState.words(),
+                                        topK_, work.candidates, work.search);
+  }
+  // senza indice, o se l'indice non trova nulla, si usano tutte le memorie
+  if (topK_ == 0 || nMemories <= topK_ || work.candidates.empty()) {
+    work.active.resize(nMemories);
+    work.overlaps.resize(nMemories);
+    for (std::size_t mu = 0; mu < nMemories; ++mu) {
+      work.active[mu] = mu;
+      work.overlaps[mu] =
+          bitDot(packedMemories_.row(mu), work.packedState.words(), dim_);
+    }
+    return;
+  }
+
+  work.scored.clear();
+  for (const std::size_t mu : work.candidates) {
+    work.scored.emplace_back(
+        bitDot(packedMemories_.row(mu), work.packedState.words(), dim_), mu);
+  }
+  const std::size_t kept{std::min(topK_, work.scored.size())};
+  const auto middle = work.scored.begin() + static_cast<std::ptrdiff_t>(kept);
+  std::nth_element(work.scored.begin(), middle - 1, work.scored.end(),
+                   std::greater<>());
+  // le tenute in ordine di memoria, come senza indice
+  std::sort(work.scored.begin(), middle,
+            [](const auto& a, const auto& b) { return a.second < b.second; });
+  work.active.resize(kept);
+  work.overlaps.resize(kept);
+  if (work.activeColumns.neurons() != dim_) {
+    work.activeColumns = BitColumns(dim_);
+  }
+  work.activeColumns.clear();
+  for (std::size_t k = 0; k < kept; ++k) {
+    work.overlaps[k] = work.scored[k].first;
+    work.active[k] = work.scored[k].second;
+    work.activeColumns.append(packedMemories_.row(work.active[k]));
+  }
+
+  // massa trascurata, relativa alla massa tenuta: le candidate scartate sono
+  // note esattamente, le altre hanno meno di threshold sottostringhe uguali
+  // alla query e overlap <= N - 2 * (sottostringhe diverse)
+  const int max{
+      *std::max_element(work.overlaps.begin(), work.overlaps.end())};
+  double keptMass{0.0};
+  for (const int overlap : work.overlaps) {
+    keptMass += std::exp(scaled(overlap - max, inverseTemp));
+  }
+  work.logTerms.clear();
+  for (auto it = middle; it != work.scored.end(); ++it) {
+    work.logTerms.push_back(scaled(it->first - max, inverseTemp));
+  }
+  const std::size_t unseen{nMemories - work.candidates.size()};
+  if (unseen > 0) {
+    const std::size_t differing{memoryIndex_.chunks() - threshold + 1};
+    const double bound{static_cast<double>(dim_) -
+                       2.0 * static_cast<double>(differing)};
+    work.logTerms.push_back(std::log(static_cast<double>(unseen)) +
+                        scaled(bound - max, inverseTemp));
+  }
+  if (!work.logTerms.empty()) {
+    const double top{
+        *std::max_element(work.logTerms.begin(), work.logTerms.end())};
+    if (std::isinf(top)) {
+      // a T = 0: trascurato tutto (+inf) o niente (-inf)
+      work.logNeglected = top;
+      return;
+    }
+    double sum{0.0};
+    for (const double term : work.logTerms) {
+      sum += std::exp(term - top);
+    }
+    work.logNeglected = top + std::log(sum) - std::log(keptMass);
+  }
+}
+
+void ModernHopfieldNetwork::updateExpTerms(double inverseTemp,
+                                           RecallWorkspace& work) const {
+  work.shift =
+      work.overlaps.empty()
+          ? 0
+          : *std::max_element(work.overlaps.begin(), work.overlaps.end());
+  for (std::size_t mu = 0; mu < work.overlaps.size(); ++mu) {
+    work.expTerms[mu] =
+        std::exp(scaled(work.overlaps[mu] - work.shift, inverseTemp));
+  }
+}
+
+// log sum_mu exp(m_mu / T) = max / T + log sum_mu exp((m_mu - max) / T)
+double ModernHopfieldNetwork::logSumExp(std::span<const int> overlaps,
+                                        double inverseTemp) const {
+  if (overlaps.empty()) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  const int max{*std::max_element(overlaps.begin(), overlaps.end())};
+  double sum{0.0};
+  for (const int overlap : overlaps) {
+    sum += std::exp(scaled(overlap - max, inverseTemp));
+  }
+  return scaled(max, inverseTemp) + std::log(sum);
+}
+
+const BitColumns& ModernHopfieldNetwork::sweepColumns(
+    const RecallWorkspace& work) const {
+  // con l'indice attivo restano k < M memorie
+  return work.active.size() == packedMemories_.size() ? memoryColumns_
+                                                      : work.activeColumns;
+}
+
+// energia dello stato corrente divisa per exp(shift / T)
+double ModernHopfieldNetwork::currentEnergy(
+    const RecallWorkspace& work) const {
+  double e = 0;
+  for (double term : work.expTerms) {
+    e -= term;
+  }
+  return e;
+}
+
+// energia dello stato con il bit l invertito: m_mu - 2 xi_mu[l] s_l, in O(M),
+// con la stessa scala di currentEnergy
+double ModernHopfieldNetwork::flippedEnergy(std::size_t l, int sl,
+                                            double inverseTemp,
+                                            RecallWorkspace& work) const {
+  const auto column = sweepColumns(work).column(l);
+  // l'exp in float non conosce scaled: a T = 0 si resta in double
+  if (floatExp_ && std::isfinite(inverseTemp)) {
+    work.expArgs.resize(work.overlaps.size());
+    for (std::size_t mu = 0; mu < work.overlaps.size(); ++mu) {
+      const int xi{bitSpin(column, mu)};
+      work.expArgs[mu] = static_cast<float>(
+          (work.overlaps[mu] - 2 * xi * sl - work.shift) * inverseTemp);
+    }
+    return -simd::kernels().expSum(work.expArgs.data(), work.expArgs.size());
+  }
+  double e = 0;
+  for (std::size_t mu = 0; mu < work.overlaps.size(); ++mu) {
+    const int xi{bitSpin(column, mu)};
+    const int flipped{work.overlaps[mu] - 2 * xi * sl};
+    e -= std::exp(scaled(flipped - work.shift, inverseTemp));
+  }
+  return e;
+}
+
+void ModernHopfieldNetwork::flipNeuron(std::size_t l, std::vector<int>& state,
+                                       double inverseTemp,
+                                       RecallWorkspace& work) const {
+  const auto column = sweepColumns(work).column(l);
+  for (std::size_t mu = 0; mu < work.overlaps.size(); ++mu) {
+    work.overlaps[mu] -= 2 * bitSpin(column, mu) * state[l];
+  }
+  // tutti i termini cambiano comunque: si riparte dal nuovo massimo
+  updateExpTerms(inverseTemp, work);
+  state[l] = -state[l];
+}
+
+bool ModernHopfieldNetwork::restorePattern(std::vector<int>& input,
+                                           RecallWorkspace& work) const {
   if (input.size() != dim_) {
     throw std::runtime_error("retrieve: input size mismatch");
   }
-  std::vector<int> state = input;
-  std::cout << '#' << std::flush;
+  if (progress_) {
+    std::cout << '#' << std::flush;
+  }
 
+  // ogni neurone e' aggiornato una volta sola: lo stato e' invariato se e
+  // solo se nessun neurone cambia
+  const double inverseTemp = cooling_.base().inverse;
+  computeOverlaps(input, inverseTemp, work);
+  bool changed{false};
   for (std::size_t l = 0; l < dim_; ++l) {
-    std::vector<int> plus = state;
-    std::vector<int> minus = state;
-    plus[l] = 1;
-    minus[l] = -1;
+    const double E_current = currentEnergy(work);
+    const double E_flipped = flippedEnergy(l, input[l], inverseTemp, work);
+    const double E_plus = input[l] > 0 ? E_current : E_flipped;
+    const double E_minus = input[l] > 0 ? E_flipped : E_current;
+
+    const int candidate = (E_plus < E_minus) ? 1 : -1;
+    if (candidate != input[l]) {
+      flipNeuron(l, input, inverseTemp, work);
+      changed = true;
+    }
+  }
+  return !changed;
+}
+
+std::vector<bool> ModernHopfieldNetwork::restoreBatch(
+    std::span<std::vector<int>> patterns, std::size_t maxSweeps) const {
+  for (const auto& pattern : patterns) {
+    if (pattern.size() != dim_) {
+      throw std::runtime_error("retrieve: input size mismatch");
+    }
+  }
+  const std::size_t nMemories{packedMemories_.size()};
+  const double inverseTemp = cooling_.base().inverse;
+  std::vector<bool> converged(patterns.size(), false);
+
+  // overlap e termini exp per memoria e pattern: matrici M x B, la riga mu
+  // contiene la memoria mu per tutti i pattern ancora attivi
+  std::size_t b{patterns.size()};
+  std::vector<std::size_t> index(b);
+  std::vector<BitPattern> packed;
+  packed.reserve(b);
+  for (std::size_t q = 0; q < b; ++q) {
+    index[q] = q;
+    packed.emplace_back(patterns[q]);
+  }
+  std::vector<int> overlaps(nMemories * b);
+  std::vector<double> expTerms(nMemories * b);
+  // a blocchi di memorie x pattern: le righe di un blocco di memorie restano
+  // in cache mentre passano tutti i pattern del blocco, e viceversa
+  constexpr std::size_t memoryTile{64};
+  constexpr std::size_t patternTile{16};
+  for (std::size_t m0 = 0; m0 < nMemories; m0 += memoryTile) {
+    const std::size_t m1{std::min(nMemories, m0 + memoryTile)};
+    for (std::size_t q0 = 0; q0 < b; q0 += patternTile) {
+      const std::size_t q1{std::min(b, q0 + patternTile)};
+      for (std::size_t mu = m0; mu < m1; ++mu) {
+        const auto memory = packedMemories_.row(mu);
+        for (std::size_t q = q0; q < q1; ++q) {
+          overlaps[mu * b + q] = bitDot(memory, packed[q].words(), dim_);
+        }
+      }
+    }
+  }
+  // come updateExpTerms, una colonna alla volta
+  std::vector<int> shifts(b);
+  auto updateColumn = [&](std::size_t q) {
+    int max{overlaps[q]};
+    for (std::size_t mu = 1; mu < nMemories; ++mu) {
+      max = std::max(max, overlaps[mu * b + q]);
+    }
+    shifts[q] = max;
+    for (std::size_t mu = 0; mu < nMemories; ++mu) {
+      expTerms[mu * b + q] =
+          std::exp(scaled(overlaps[mu * b + q] - max, inverseTemp));
+    }
+  };
+  for (std::size_t q = 0; q < b && nMemories > 0; ++q) {
+    updateColumn(q);
+  }
 
-    double E_plus = energyPerState(plus, 0);
-    double E_minus = energyPerState(minus, 0);
+  // stesse somme, nello stesso ordine, di currentEnergy e flippedEnergy
+  std::vector<double> current(b);
+  std::vector<double> flipped(b);
+  std::vector<int> spins(b);
+  std::vector<char> changed;
+  for (std::size_t sweep = 0; sweep < maxSweeps && b > 0; ++sweep) {
+    changed.assign(b, 0);
+    for (std::size_t l = 0; l < dim_; ++l) {
+      for (std::size_t q = 0; q < b; ++q) {
+        spins[q] = patterns[index[q]][l];
+        current[q] = 0.0;
+        flipped[q] = 0.0;
+      }
+      const auto column = memoryColumns_.column(l);
+      for (std::size_t mu = 0; mu < nMemories; ++mu) {
+        const int xi{bitSpin(column, mu)};
+        const int* m = overlaps.data() + mu * b;
+        const double* e = expTerms.data() + mu * b;
+        for (std::size_t q = 0; q < b; ++q) {
+          current[q] -= e[q];
+          flipped[q] -= std::exp(
+              scaled(m[q] - 2 * xi * spins[q] - shifts[q], inverseTemp));
+        }
+      }
+      for (std::size_t q = 0; q < b; ++q) {
+        const double E_plus = spins[q] > 0 ? current[q] : flipped[q];
+        const double E_minus = spins[q] > 0 ? flipped[q] : current[q];
+        const int candidate = (E_plus < E_minus) ? 1 : -1;
+        if (candidate != spins[q]) {
+          for (std::size_t mu = 0; mu < nMemories; ++mu) {
+            overlaps[mu * b + q] -= 2 * bitSpin(column, mu) * spins[q];
+          }
+          updateColumn(q);
+          patterns[index[q]][l] = candidate;
+          changed[q] = 1;
+        }
+      }
+    }
+    for (std::size_t q = 0; q < b; ++q) {
+      converged[index[q]] = !changed[q];
+    }
+    keepColumns(index, b, changed);
+    keepColumns(overlaps, b, changed);
+    keepColumns(expTerms, b, changed);
+    keepColumns(shifts, b, changed);
+    b = index.size();
+  }
+  return converged;
+}
 
-    state[l] = (E_plus < E_minus) ? 1 : -1;
+std::vector<double> ModernHopfieldNetwork::attentionUpdate(
+    std::span<const double> state, double beta) const {
+  if (state.size() != dim_) {
+    throw std::runtime_error("retrieve: input size mismatch");
   }
-  if (state == input) {
-    return true;
-  } else {
-    input = state;
-    return false;
+  const std::size_t nMemories{packedMemories_.size()};
+  std::vector<double> result(dim_, 0.0);
+  if (nMemories == 0) {
+    return result;
+  }
+  // lo stato continuo non si impacchetta: overlap in double sulle righe
+  std::vector<double> overlaps(nMemories);
+  for (std::size_t mu = 0; mu < nMemories; ++mu) {
+    const auto memory = packedMemories_.row(mu);
+    double sum{0.0};
+    for (std::size_t i = 0; i < dim_; ++i) {
+      sum += bitSpin(memory, i) * state[i];
+    }
+    overlaps[mu] = sum;
   }
+  const double max{*std::max_element(overlaps.begin(), overlaps.end())};
+  double total{0.0};
+  for (double& overlap : overlaps) {
+    overlap = std::exp((overlap - max) * beta);
+    total += overlap;
+  }
+  for (std::size_t mu = 0; mu < nMemories; ++mu) {
+    const double weight{overlaps[mu] / total};
+    const auto memory = packedMemories_.row(mu);
+    for (std::size_t i = 0; i < dim_; ++i) {
+      result[i] += weight * bitSpin(memory, i);
+    }
+  }
+  return result;
 }
 
-bool ModernHopfieldNetwork::probability(double dE, double temp) const {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<> distrib(0.0, 1.0);
+bool ModernHopfieldNetwork::restoreAttention(std::vector<int>& input,
+                                             double beta,
+                                             std::size_t maxSteps) const {
+  if (input.size() != dim_) {
+    throw std::runtime_error("retrieve: input size mismatch");
+  }
+  const std::size_t nMemories{packedMemories_.size()};
+  if (nMemories == 0) {
+    return true;
+  }
+  // buffer della chiamata: la rete si puo' usare da piu' thread insieme
+  std::vector<int> overlaps(nMemories);
+  std::vector<double> weights(nMemories);
+  std::vector<double> field(dim_);
+  bool changed{true};
+  for (std::size_t step = 0; step < maxSteps && changed; ++step) {
+    // stato binario: gli overlap si calcolano con xor e popcount
+    const BitPattern packed(input);
+    for (std::size_t mu = 0; mu < nMemories; ++mu) {
+      overlaps[mu] = bitDot(packedMemories_.row(mu), packed.words(), dim_);
+    }
+    // p = softmax(beta * overlaps)
+    const int max{*std::max_element(overlaps.begin(), overlaps.end())};
+    double sum{0.0};
+    for (std::size_t mu = 0; mu < nMemories; ++mu) {
+      weights[mu] = std::exp((overlaps[mu] - max) * beta);
+      sum += weights[mu];
+    }
+    std::fill(field.begin(), field.end(), 0.0);
+    for (std::size_t mu = 0; mu < nMemories; ++mu) {
+      const double weight{weights[mu] / sum};
+      const auto memory = packedMemories_.row(mu);
+      for (std::size_t i = 0; i < dim_; ++i) {
+        field[i] += weight * bitSpin(memory, i);
+      }
+    }
+    changed = false;
+    for (std::size_t i = 0; i < dim_; ++i) {
+      const int spin{field[i] > 0.0   ? 1
+                     : field[i] < 0.0 ? -1
+                                      : input[i]};
+      if (spin != input[i]) {
+        input[i] = spin;
+        changed = true;
+      }
+    }
+  }
+  return !changed;
+}
 
-  long double prob = std::exp((-std::abs(dE) / (temp)));
-  double r = distrib(
-      gen);  // non static_cast a unsigned int, ti serve un double tra 0 e 1
+bool ModernHopfieldNetwork::probability(double dE, double temp,
+                                        UniformStream& uniform) const {
+  return acceptMove(dE, Temperature{temp, 1.0 / temp}, uniform);
+}
 
-  return r < prob;
+bool ModernHopfieldNetwork::acceptMove(double dE, const Temperature& temp,
+                                       UniformStream& uniform) const {
+  // a T = 0 discesa pura, senza esponenziali: il candidato non alza mai
+  // l'energia, e passa solo se la abbassa davvero
+  if (temp.value <= 0.0) {
+    return dE != 0.0;
+  }
+  // le uniformi arrivano a blocchi dallo stream, senza chiamate di sistema
+  const double prob = std::exp(-std::abs(dE) * temp.inverse);
+  return uniform() < prob;
 }
 
+// -sum_mu exp(m_mu / T) calcolata come -exp(log-sum-exp): l'unico overflow
+// possibile e' quello del risultato finale
 double ModernHopfieldNetwork::energyPerState(const std::vector<int>& state,
                                              int n) const {
-  double e = 0;
-  for (const auto& v : patternMatrix_.getMatrix()) {
-    if (state.size() != v.size()) {
-      throw std::runtime_error("Energy: state size mismatch");
-    }
-    e -= std::exp(dot(v, state) / CoolingSchedule(n));
+  if (packedMemories_.size() == 0) {
+    return 0.0;
   }
-  return e;
+  return -std::exp(logEnergyPerState(state, n));
 }
 
-double ModernHopfieldNetwork::CoolingSchedule(int iter) const {
-  double temp;
-  if (iter == 0) {
-    temp = temp_0_;
-    return temp;
+double ModernHopfieldNetwork::logEnergyPerState(const std::vector<int>& state,
+                                                int n) const {
+  if (packedMemories_.size() > 0 && state.size() != dim_) {
+    throw std::runtime_error("Energy: state size mismatch");
   }
+  // lo stato puo' non essere +-1: prodotti in int, spin letti dai bit
+  std::vector<int> overlaps(packedMemories_.size());
+  for (std::size_t mu = 0; mu < overlaps.size(); ++mu) {
+    overlaps[mu] = static_cast<int>(dot(packedMemories_.row(mu), state));
+  }
+  return logSumExp(overlaps, cooling_.at(n).inverse);
+}
 
-  // annealing functions
-  // temp = static_cast<float>(temp_0_ * std::pow(0.8, iter));
-  temp = static_cast<float>(temp_0_ * (1 / std::log(2 + iter)));
-  // temp = static_cast<float>(temp_0 - 0.9*iter);
-
-  if (temp < 0.01) {
-    temp = 0.0;
+// stessa energia, con i prodotti scalari fatti con xor e popcount
+double ModernHopfieldNetwork::energyPerState(const BitPattern& state,
+                                             int n) const {
+  if (packedMemories_.size() == 0) {
+    return 0.0;
+  }
+  if (state.size() != dim_) {
+    throw std::runtime_error("Energy: state size mismatch");
   }
-  return temp;
+  std::vector<int> overlaps(packedMemories_.size());
+  for (std::size_t mu = 0; mu < overlaps.size(); ++mu) {
+    overlaps[mu] = bitDot(packedMemories_.row(mu), state.words(), dim_);
+  }
+  return -std::exp(logSumExp(overlaps, cooling_.at(n).inverse));
+}
+
+double ModernHopfieldNetwork::CoolingSchedule(int iter) const {
+  return cooling_.at(iter).value;
 }
 
 bool ModernHopfieldNetwork::restorePattern_withAnnealing(
-    std::vector<int>& pattern, int n) const {
+    std::vector<int>& pattern, int n, RecallWorkspace& work,
+    UniformStream& uniform) const {
   if (pattern.size() != dim_) {
     throw std::runtime_error("retrieve: input size mismatch");
   }
-  std::vector<int> state = pattern;
-  std::cout << '#' << std::flush;
+  if (progress_) {
+    std::cout << '#' << std::flush;
+  }
 
+  // la corsa adattiva riparte solo qui, al primo sweep (o con un workspace
+  // nuovo), da una copia della politica della rete
+  if (n == 0 || !work.cooling) {
+    work.cooling = cooling_;
+    work.cooling->reset();
+  }
+  const Temperature temp = work.cooling->at(n);
+  computeOverlaps(pattern, temp.inverse, work);
+  std::size_t accepted{0};
   for (std::size_t l = 0; l < dim_; ++l) {
-    std::vector<int> plus = state;
-    std::vector<int> minus = state;
-    plus[l] = 1;
-    minus[l] = -1;
-
-    double E_plus = energyPerState(plus, n);
-    double E_minus = energyPerState(minus, n);
-
-    int candidate = (E_plus < E_minus) ? 1 : -1;
-
-    if (candidate != state[l]) {
-      //state[l] = candidate;
-      double E0 = candidate > 0 ? E_plus : E_minus;
-      double dE = energyPerState(state, n) - E0;
+    const double E_current = currentEnergy(work);
+    const double E_flipped = flippedEnergy(l, pattern[l], temp.inverse, work);
+    const double E_plus = pattern[l] > 0 ? E_current : E_flipped;
+    const double E_minus = pattern[l] > 0 ? E_flipped : E_current;
+
+    const int candidate = (E_plus < E_minus) ? 1 : -1;
+
+    if (candidate != pattern[l]) {
+      // candidate != stato: l'energia del candidato e' E_flipped. Le due
+      // energie sono divise per exp(shift / T), dE va riportato in scala
+      double dE = E_current - E_flipped;
+      if (dE != 0.0 && temp.value > 0.0) {
+        dE *= std::exp(work.shift * temp.inverse);
+      }
 
-      if (probability(dE, CoolingSchedule(n))) {
-        state[l] = candidate;
+      if (acceptMove(dE, temp, uniform)) {
+        flipNeuron(l, pattern, temp.inverse, work);
+        ++accepted;
       }
     }
   }
-  if (state == pattern) {
-    return true;
-  } else {
-    pattern = state;
-    return false;
-  }
+  work.cooling->observe(static_cast<double>(accepted) /
+                        static_cast<double>(dim_));
+  return accepted == 0;
 }
 
 }  // namespace abc
\ No newline at end of file
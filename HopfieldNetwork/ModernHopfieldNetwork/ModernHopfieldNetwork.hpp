@@ -1,44 +1,192 @@
 #ifndef HOPFIELDNEURALNETWORK_MODERNHOPFIELDNETWORK_H
 #define HOPFIELDNEURALNETWORK_MODERNHOPFIELDNETWORK_H
 
+#include <limits>
+#include <optional>
+#include <utility>
+
+#include "../Matrix/BitPattern.hpp"
+#include "../Matrix/CoolingSchedule.hpp"
 #include "../Matrix/Matrix.hpp"
+#include "../Matrix/MemoryIndex.hpp"
+#include "../Matrix/Random.hpp"
+#include "../Matrix/SimdKernels.hpp"
 
 namespace abc {
 class ModernHopfieldNetwork {
+ public:
+  // stato di un recupero: overlap m_mu = <xi_mu, s> di ogni memoria con lo
+  // stato corrente e i termini exp((m_mu - shift) / T), con shift = max m_mu
+  // (log-sum-exp: il termine piu' grande vale 1 e niente va in overflow anche
+  // a temperature basse), piu' la temperatura dell'annealing. I buffer sono
+  // riusati fra gli sweep, cosi' il recupero non alloca; la rete resta const,
+  // e per recuperare in parallelo basta un workspace per thread
+  struct RecallWorkspace {
+    // memorie usate dallo sweep (tutte, o le top-k candidate dell'indice):
+    // overlaps[k] e expTerms[k] si riferiscono alla memoria active[k]
+    std::vector<std::size_t> active;
+    // colonne delle sole memorie di active quando l'indice ne tiene k
+    BitColumns activeColumns;
+    std::vector<int> overlaps;
+    std::vector<double> expTerms;
+    int shift{0};
+    std::vector<float> expArgs;  // argomenti per l'exp in float
+    BitPattern packedState;
+    std::vector<std::size_t> candidates;
+    MultiIndexHash::SearchWorkspace search;
+    std::vector<std::pair<int, std::size_t>> scored;
+    std::vector<double> logTerms;  // termini della massa trascurata
+    // log del limite della massa trascurata all'inizio dell'ultimo sweep
+    double logNeglected{-std::numeric_limits<double>::infinity()};
+    // copia della politica della rete, ripartita al primo sweep
+    std::optional<Cooling> cooling;
+  };
+
  private:
-  Matrix<int> patternMatrix_;
+  // memorie a 1 bit per spin (riga mu = parole di xi_mu): sono l'unica copia
+  // completa, la forma in int si ricostruisce per getMatrix() e per i file
+  Matrix<std::uint64_t> packedMemories_;
+  // le stesse memorie per neurone: la colonna l contiene xi_mu[l] per ogni
+  // mu, cosi' il recupero legge un neurone di tutte le memorie in sequenza
+  BitColumns memoryColumns_;
+  // matrice di Gram delle memorie, triangolo inferiore a righe: la riga mu
+  // (da mu * (mu - 1) / 2) contiene <xi_mu, xi_nu> per nu < mu. Si allunga di
+  // una riga a ogni learnPattern
+  std::vector<int> gram_;
   std::size_t dim_{10000};
-  double temp_0_{500};
- 
+  Cooling cooling_{500.0};  // temperatura iniziale 500
 
-  double dot(const std::vector<int>& a,
-                                    const std::vector<int>& b) const;
+  // indice delle memorie per il recupero sulle sole top-k (topK_ > 0):
+  // costruito da setTopK e aggiornato da learnPattern e loadMemory, il
+  // recupero lo legge soltanto
+  MultiIndexHash memoryIndex_;
+  std::size_t topK_{0};
+  bool floatExp_{false};
+  bool progress_{true};
+  // workspace dei metodi di recupero senza workspace esplicito
+  RecallWorkspace workspace_;
+
+  // <xi_mu, state> con uno stato int qualsiasi
+  double dot(std::span<const std::uint64_t> memory,
+             std::span<const int> state) const;
+  double dot(const BitPattern& a, const BitPattern& b) const;
+  // impacchetta e aggiunge una memoria (solo +1 e -1) gia' della dimensione
+  void appendMemory(std::span<const int> pattern);
+  // sostituisce tutte le memorie con le righe di memories
+  void packMemories(const Matrix<int>& memories);
+  // tutte le memorie impacchettate, una riga dopo l'altra
+  std::span<const std::uint64_t> packedRows() const;
+  // ricostruisce l'indice se il recupero top-k e' attivo
+  void rebuildMemoryIndex();
+  // aggiunge a gram_ la riga dell'ultima memoria
+  void appendGramRow();
+  // colonne dello sweep: bitSpin(sweepColumns(work).column(l), k) = xi[l]
+  // della memoria work.active[k]
+  const BitColumns& sweepColumns(const RecallWorkspace& work) const;
+  // sceglie work.active e calcola i suoi overlap con work.packedState
+  void selectMemories(double inverseTemp, RecallWorkspace& work) const;
+  // inverseTemp = 1 / T dello sweep
+  void computeOverlaps(const std::vector<int>& state, double inverseTemp,
+                       RecallWorkspace& work) const;
+  void updateExpTerms(double inverseTemp, RecallWorkspace& work) const;
+  double logSumExp(std::span<const int> overlaps, double inverseTemp) const;
+  double currentEnergy(const RecallWorkspace& work) const;
+  double flippedEnergy(std::size_t l, int sl, double inverseTemp,
+                       RecallWorkspace& work) const;
+  void flipNeuron(std::size_t l, std::vector<int>& state, double inverseTemp,
+                  RecallWorkspace& work) const;
+  bool acceptMove(double dE, const Temperature& temp,
+                  UniformStream& uniform) const;
 
  public:
   ModernHopfieldNetwork();
   ModernHopfieldNetwork(int dimension);
 
   void learnPattern(const std::vector<int>& pattern);
-  void save(const std::string& filepath) const;
+  // il formato binario e' quello predefinito, il testo resta per l'export
+  void save(const std::string& filepath,
+            FileFormat format = FileFormat::Binary) const;
   void loadMemory(const std::string& filepath);
 
   // getter
-  const Matrix<int>& getMatrix() const;
+  // le memorie in int, ricostruite dai bit a ogni chiamata
+  Matrix<int> getMatrix() const;
+  std::size_t neurons() const { return dim_; }
+  // dalla matrice di Gram, senza ricalcolare i prodotti scalari
   double totalSystemEnergy() const;
+  // overlap della memoria mu con le memorie precedenti (0..mu-1): subito
+  // dopo learnPattern, la riga dell'ultima dice se era gia' memorizzata
+  std::span<const int> memoryOverlaps(std::size_t mu) const;
+  // coppie (nu, mu), nu < mu, con overlap >= minOverlap: minOverlap = N
+  // trova i duplicati, N - 2 d le memorie a distanza di Hamming <= d
+  std::vector<std::pair<std::size_t, std::size_t>> nearDuplicates(
+      int minOverlap) const;
 
   //setter
   void setTemp0(double energy);
 
 
 //modern-classic
-  bool restorePattern(std::vector<int>& input);
+  bool restorePattern(std::vector<int>& input) {
+    return restorePattern(input, workspace_);
+  }
+  // lo stesso sweep con lo stato in work: piu' thread possono recuperare
+  // dalla stessa rete, ognuno con il suo workspace
+  bool restorePattern(std::vector<int>& input, RecallWorkspace& work) const;
+  // come restorePattern ripetuto fino alla convergenza (al massimo
+  // maxSweeps), ma per piu' pattern insieme: ogni memoria e' letta una volta
+  // per tutti i pattern del blocco, e chi converge esce. Ritorna per ogni
+  // pattern se e' arrivato a convergenza
+  std::vector<bool> restoreBatch(std::span<std::vector<int>> patterns,
+                                 std::size_t maxSweeps = 100) const;
+
+//modern-attention
+  // aggiornamento continuo s <- Xi^T softmax(beta Xi s): un prodotto per
+  // calcolare gli overlap e uno per tornare nello spazio dei neuroni. Con
+  // beta grande il risultato e' ~ la memoria piu' vicina
+  std::vector<double> attentionUpdate(std::span<const double> state,
+                                      double beta) const;
+  // lo stesso aggiornamento binarizzato (segno di ogni componente, lo spin
+  // resta com'e' se la componente e' zero), ripetuto al massimo maxSteps
+  // volte. Ritorna true se l'ultimo passo non ha cambiato nulla
+  bool restoreAttention(std::vector<int>& input, double beta,
+                        std::size_t maxSteps = 2) const;
 
 //modern-annealing
-  bool probability(double dE, double temp) const ;
+  bool probability(double dE, double temp,
+                   UniformStream& uniform = threadUniformStream()) const;
   double CoolingSchedule(int iter) const ;
+  // logaritmica di default, a partire dalla temperatura di setTemp0
+  void setCoolingSchedule(CoolingPolicy policy) { cooling_.setPolicy(policy); }
+  // le uniformi arrivano da uniform (di default lo stream del thread): stesso
+  // seme, stessa sequenza di mosse accettate
+  bool restorePattern_withAnnealing(
+      std::vector<int>& pattern, int n,
+      UniformStream& uniform = threadUniformStream()) {
+    return restorePattern_withAnnealing(pattern, n, workspace_, uniform);
+  }
+  // con lo stato (e la temperatura adattiva) in work
   bool restorePattern_withAnnealing(
-    std::vector<int>& pattern, int n) const ;
+      std::vector<int>& pattern, int n, RecallWorkspace& work,
+      UniformStream& uniform = threadUniformStream()) const;
   double energyPerState(const std::vector<int>& state, int n) const;
+  double energyPerState(const BitPattern& state, int n) const;
+  // log(-E) = log sum_mu exp(m_mu / T): finito anche quando E non lo e'
+  double logEnergyPerState(const std::vector<int>& state, int n) const;
+  // exp in float vettoriale per i termini delle energie con un bit invertito
+  // (restorePattern e restorePattern_withAnnealing): piu' veloce, errore
+  // relativo ~1e-7 sui termini. restoreBatch resta in double
+  void setFloatExp(bool enabled) { floatExp_ = enabled; }
+  // un '#' su std::cout a ogni sweep di restorePattern e dell'annealing
+  void setProgress(bool enabled) { progress_ = enabled; }
+  // restorePattern e restorePattern_withAnnealing usano solo le k memorie
+  // con overlap maggiore fra quelle che l'indice trova vicine alla query
+  // (0 = tutte). Le energie pubbliche e restoreBatch restano esatte
+  void setTopK(std::size_t k);
+  // log del limite superiore di (massa exp trascurata) / (massa tenuta)
+  // all'inizio dell'ultimo sweep senza workspace esplicito; -inf se non si e'
+  // trascurato nulla (con un workspace: work.logNeglected)
+  double logNeglectedMassBound() const { return workspace_.logNeglected; }
 
 };
 }  // namespace abc
@@ -2,6 +2,12 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "ModernHopfieldNetwork.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+#include "../Matrix/TempFile.hpp"
 #include "../doctest.h"
 TEST_CASE("Testing constructor") {
   CHECK_THROWS_WITH_AS(abc::ModernHopfieldNetwork{0},
@@ -24,6 +30,336 @@ TEST_CASE(
 
   CHECK(net.restorePattern(corrupted_pat));
 }
+TEST_CASE("Testing restorePattern - incremental overlaps match the energy") {
+  const std::size_t dim{40};
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> coin(0, 1);
+  auto randomPattern = [&]() {
+    std::vector<int> pattern(dim);
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    return pattern;
+  };
+
+  abc::ModernHopfieldNetwork net(static_cast<int>(dim));
+  for (int p = 0; p < 5; ++p) {
+    net.learnPattern(randomPattern());
+  }
+  net.setTemp0(2.0);
+
+  // riferimento: due energie complete per ogni neurone
+  auto referenceSweep = [&](std::vector<int>& state) {
+    for (std::size_t l = 0; l < dim; ++l) {
+      std::vector<int> plus = state;
+      std::vector<int> minus = state;
+      plus[l] = 1;
+      minus[l] = -1;
+      state[l] = net.energyPerState(plus, 0) < net.energyPerState(minus, 0)
+                     ? 1
+                     : -1;
+    }
+  };
+
+  std::vector<int> query = randomPattern();
+  std::vector<int> reference = query;
+  bool converged{false};
+  for (int sweep = 0; sweep < 10 && !converged; ++sweep) {
+    converged = net.restorePattern(query);
+    referenceSweep(reference);
+    CHECK(query == reference);
+  }
+  CHECK(converged);
+}
+TEST_CASE("Testing restoreBatch - same result as one query at a time") {
+  const std::size_t dim{70};
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<int> coin(0, 1);
+  auto randomPattern = [&]() {
+    std::vector<int> pattern(dim);
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    return pattern;
+  };
+  abc::ModernHopfieldNetwork net(static_cast<int>(dim));
+  for (int p = 0; p < 6; ++p) {
+    net.learnPattern(randomPattern());
+  }
+  net.setTemp0(3.0);
+
+  std::vector<std::vector<int>> queries;
+  for (int q = 0; q < 5; ++q) {
+    queries.push_back(randomPattern());
+  }
+  const auto memories = net.getMatrix();
+  const auto memory = memories.getMatrix()[1];
+  queries.emplace_back(memory.begin(), memory.end());
+  std::vector<std::vector<int>> expected = queries;
+  for (auto& query : expected) {
+    for (int sweep = 0; sweep < 20 && !net.restorePattern(query); ++sweep) {
+    }
+  }
+
+  const auto converged = net.restoreBatch(queries);
+  CHECK(queries == expected);
+  CHECK(std::all_of(converged.begin(), converged.end(),
+                    [](bool c) { return c; }));
+
+  SUBCASE("sweep limit") {
+    std::vector<std::vector<int>> limited{randomPattern()};
+    const auto start = limited[0];
+    CHECK(net.restoreBatch(limited, 0) == std::vector<bool>{false});
+    CHECK(limited[0] == start);
+    std::vector<std::vector<int>> wrong{std::vector<int>(dim + 1, 1)};
+    CHECK_THROWS_WITH_AS(net.restoreBatch(wrong),
+                         "retrieve: input size mismatch", std::runtime_error);
+  }
+}
+TEST_CASE("Testing restoreBatch - const recall from several threads") {
+  // piu' memorie e pattern dei blocchi degli overlap
+  const std::size_t dim{70};
+  std::mt19937 gen(8);
+  std::uniform_int_distribution<int> coin(0, 1);
+  abc::ModernHopfieldNetwork net(static_cast<int>(dim));
+  for (int p = 0; p < 90; ++p) {
+    std::vector<int> pattern(dim);
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    net.learnPattern(pattern);
+  }
+  net.setTemp0(3.0);
+  std::vector<std::vector<int>> queries;
+  const auto memories = net.getMatrix();
+  for (std::size_t q = 0; q < 40; ++q) {
+    const auto memory = memories.getMatrix()[q * 2];
+    queries.emplace_back(memory.begin(), memory.end());
+    for (std::size_t i = q % 5; i < dim; i += 9) {
+      queries.back()[i] = -queries.back()[i];
+    }
+  }
+  std::vector<std::vector<int>> expected = queries;
+  for (auto& query : expected) {
+    for (int sweep = 0; sweep < 20 && !net.restorePattern(query); ++sweep) {
+    }
+  }
+  std::vector<std::vector<int>> attention = queries;
+  for (auto& query : attention) {
+    net.restoreAttention(query, 0.5);
+  }
+
+  // i metodi const non hanno stato condiviso: due thread sulla stessa rete
+  const abc::ModernHopfieldNetwork& shared{net};
+  std::vector<std::vector<int>> batch = queries;
+  std::vector<std::vector<int>> parallelAttention = queries;
+  const std::span<std::vector<int>> all{batch};
+  std::thread first([&]() { shared.restoreBatch(all.first(20)); });
+  std::thread second([&]() {
+    shared.restoreBatch(all.last(20));
+    for (auto& query : parallelAttention) {
+      shared.restoreAttention(query, 0.5);
+    }
+  });
+  first.join();
+  second.join();
+  CHECK(batch == expected);
+  CHECK(parallelAttention == attention);
+}
+TEST_CASE("Testing restoreAttention - one softmax step restores a memory") {
+  const std::size_t dim{200};
+  std::mt19937 gen(23);
+  std::uniform_int_distribution<int> coin(0, 1);
+  abc::ModernHopfieldNetwork net(static_cast<int>(dim));
+  std::vector<std::vector<int>> stored(8, std::vector<int>(dim));
+  for (auto& pattern : stored) {
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    net.learnPattern(pattern);
+  }
+  std::vector<int> query = stored[3];
+  for (std::size_t i = 0; i < dim; i += 4) query[i] = -query[i];
+
+  // il primo passo arriva alla memoria, il secondo conferma il punto fisso
+  CHECK(net.restoreAttention(query, 0.1));
+  CHECK(query == stored[3]);
+  CHECK(net.restoreAttention(query, 0.1, 1));
+
+  SUBCASE("continuous output") {
+    const std::vector<double> state(stored[3].begin(), stored[3].end());
+    // beta nullo: media delle memorie
+    const auto mean = net.attentionUpdate(state, 0.0);
+    double expected{0.0};
+    for (const auto& pattern : stored) expected += pattern[0];
+    CHECK(mean[0] == doctest::Approx(expected / 8.0));
+    // beta grande: la memoria stessa, senza overflow
+    const auto sharp = net.attentionUpdate(state, 50.0);
+    for (std::size_t i = 0; i < dim; ++i) {
+      CHECK(sharp[i] == doctest::Approx(stored[3][i]));
+    }
+  }
+  SUBCASE("size mismatch") {
+    std::vector<int> wrong(dim + 1, 1);
+    CHECK_THROWS_WITH_AS(net.restoreAttention(wrong, 1.0),
+                         "retrieve: input size mismatch", std::runtime_error);
+  }
+}
+TEST_CASE("Testing setTopK - recall over the indexed top-k memories") {
+  const std::size_t dim{1024};
+  std::mt19937 gen(29);
+  std::uniform_int_distribution<int> coin(0, 1);
+  abc::ModernHopfieldNetwork full(static_cast<int>(dim));
+  abc::ModernHopfieldNetwork pruned(static_cast<int>(dim));
+  pruned.setTopK(4);
+  std::vector<std::vector<int>> stored(200, std::vector<int>(dim));
+  for (auto& pattern : stored) {
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    full.learnPattern(pattern);
+    pruned.learnPattern(pattern);
+  }
+  full.setTemp0(0.5);
+  pruned.setTemp0(0.5);
+
+  // 5% di rumore: molte sottostringhe restano intatte
+  std::vector<int> query = stored[42];
+  for (std::size_t i = 0; i < dim; i += 20) query[i] = -query[i];
+  std::vector<int> reference = query;
+  bool converged{false};
+  for (int sweep = 0; sweep < 5 && !converged; ++sweep) {
+    converged = pruned.restorePattern(query);
+    full.restorePattern(reference);
+    CHECK(query == reference);
+    // le 196 memorie trascurate pesano meno dell'1% di quelle tenute
+    CHECK(std::isfinite(pruned.logNeglectedMassBound()));
+    CHECK(pruned.logNeglectedMassBound() < std::log(1e-2));
+  }
+  CHECK(converged);
+  CHECK(query == stored[42]);
+  CHECK(std::isinf(full.logNeglectedMassBound()));
+
+  SUBCASE("no candidates - all memories are used") {
+    std::vector<int> far(dim);
+    for (std::size_t i = 0; i < dim; ++i) far[i] = -stored[0][i];
+    for (std::size_t i = 0; i < dim; i += 16) far[i] = coin(gen) ? 1 : -1;
+    std::vector<int> farReference = far;
+    pruned.restorePattern(far);
+    full.restorePattern(farReference);
+    CHECK(far == farReference);
+  }
+  SUBCASE("one const network, one workspace per thread") {
+    // l'indice e' costruito da learnPattern: le ricerche lo leggono soltanto
+    pruned.setProgress(false);
+    pruned.setCoolingSchedule(abc::AdaptiveCooling{});
+    std::vector<std::vector<int>> queries;
+    for (std::size_t q = 0; q < 8; ++q) {
+      queries.push_back(stored[q * 20]);
+      for (std::size_t i = q; i < dim; i += 20) {
+        queries.back()[i] = -queries.back()[i];
+      }
+    }
+    // query pari senza annealing, dispari con l'annealing adattivo
+    auto recall = [](auto& network, std::vector<int>& state, std::size_t q,
+                     auto&... work) {
+      abc::UniformStream uniform(q);
+      for (int n = 0; n < 10; ++n) {
+        if (q % 2 == 0 ? network.restorePattern(state, work...)
+                       : network.restorePattern_withAnnealing(
+                             state, n, work..., uniform)) {
+          break;
+        }
+      }
+    };
+    // riferimento in sequenza, con il workspace della rete
+    std::vector<std::vector<int>> expected = queries;
+    for (std::size_t q = 0; q < expected.size(); ++q) {
+      recall(pruned, expected[q], q);
+    }
+
+    const abc::ModernHopfieldNetwork& shared{pruned};
+    std::vector<std::vector<int>> parallel = queries;
+    std::vector<double> neglected(2);
+    auto half = [&](std::size_t first) {
+      abc::ModernHopfieldNetwork::RecallWorkspace work;
+      for (std::size_t q = first; q < parallel.size(); q += 2) {
+        recall(shared, parallel[q], q, work);
+      }
+      neglected[first] = work.logNeglected;
+    };
+    std::thread even(half, 0);
+    std::thread odd(half, 1);
+    even.join();
+    odd.join();
+    CHECK(parallel == expected);
+    CHECK(neglected[0] < std::log(1e-2));
+    CHECK(std::isfinite(neglected[1]));
+  }
+}
+TEST_CASE("Testing setTopK - loadMemory rebuilds the index") {
+  std::mt19937 gen(31);
+  std::uniform_int_distribution<int> coin(0, 1);
+  // due file con lo stesso numero di memorie, diverse e di altra dimensione
+  const abc::TempFile firstFile("modern_topk_a.bin");
+  const abc::TempFile secondFile("modern_topk_b.bin");
+  std::vector<std::vector<int>> first(40, std::vector<int>(1024));
+  std::vector<std::vector<int>> second(40, std::vector<int>(512));
+  {
+    abc::ModernHopfieldNetwork a;
+    abc::ModernHopfieldNetwork b;
+    for (std::size_t mu = 0; mu < first.size(); ++mu) {
+      for (auto& v : first[mu]) v = coin(gen) ? 1 : -1;
+      for (auto& v : second[mu]) v = coin(gen) ? 1 : -1;
+      a.learnPattern(first[mu]);
+      b.learnPattern(second[mu]);
+    }
+    a.save(firstFile.path());
+    b.save(secondFile.path());
+  }
+
+  abc::ModernHopfieldNetwork pruned;
+  pruned.setTopK(4);
+  pruned.setTemp0(0.5);
+  pruned.loadMemory(firstFile.path());
+  std::vector<int> query = first[7];
+  pruned.restorePattern(query);  // l'indice delle prime memorie
+  CHECK(std::isfinite(pruned.logNeglectedMassBound()));
+
+  pruned.loadMemory(secondFile.path());
+  query = second[7];
+  for (std::size_t i = 0; i < query.size(); i += 20) query[i] = -query[i];
+  bool converged{false};
+  for (int sweep = 0; sweep < 5 && !converged; ++sweep) {
+    converged = pruned.restorePattern(query);
+    // l'indice trova le memorie del secondo file: si tengono solo le top-k
+    CHECK(std::isfinite(pruned.logNeglectedMassBound()));
+  }
+  CHECK(converged);
+  CHECK(query == second[7]);
+}
+TEST_CASE("Testing low temperature - log-sum-exp energies") {
+  // m / T arriva a 4000 / 4.5 ~ 889: exp(m / T) non e' rappresentabile
+  const std::size_t dim{4000};
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<int> coin(0, 1);
+  abc::ModernHopfieldNetwork net(static_cast<int>(dim));
+  std::vector<std::vector<int>> stored(3, std::vector<int>(dim));
+  for (auto& pattern : stored) {
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    net.learnPattern(pattern);
+  }
+  net.setTemp0(1.0);
+
+  const double logEnergy{net.logEnergyPerState(stored[0], 0)};
+  CHECK(std::isfinite(logEnergy));
+  CHECK(logEnergy == doctest::Approx(dim / 4.5).epsilon(1e-6));
+  CHECK(std::isinf(net.energyPerState(stored[0], 0)));
+
+  std::vector<int> query = stored[1];
+  for (std::size_t i = 0; i < dim; i += 8) query[i] = -query[i];
+  std::vector<int> fastQuery = query;
+  for (int sweep = 0; sweep < 5 && !net.restorePattern(query); ++sweep) {
+  }
+  CHECK(query == stored[1]);
+
+  SUBCASE("float exp path") {
+    net.setFloatExp(true);
+    for (int sweep = 0; sweep < 5 && !net.restorePattern(fastQuery); ++sweep) {
+    }
+    CHECK(fastQuery == stored[1]);
+  }
+}
 TEST_CASE("Testing setting T0") {
   abc::ModernHopfieldNetwork net;
   double energy{10.0};
@@ -50,6 +386,12 @@ TEST_CASE("Testing energyPerState") {
     double computedEnergy = net.energyPerState(state, 0);
     CHECK(doctest::Approx(computedEnergy).epsilon(0.0001) == expectedEnergy);
   }
+  SUBCASE("Bit-packed state gives the same energy") {
+    net.learnPattern(pattern1);
+    net.learnPattern(pattern2);
+    CHECK(net.energyPerState(abc::BitPattern(state), 0) ==
+          doctest::Approx(net.energyPerState(state, 0)));
+  }
   SUBCASE("Handles empty matrix") {
     double computedEnergy = net.energyPerState(state, 0);
 
@@ -86,6 +428,30 @@ TEST_CASE("Testing totalEnergy - computes correct energy") {
 
   CHECK(doctest::Approx(net.totalSystemEnergy()).epsilon(1e-6) ==
         expectedEnergy);
+
+  SUBCASE("cached overlaps and near duplicates") {
+    CHECK(net.memoryOverlaps(0).empty());
+    CHECK(std::vector<int>(net.memoryOverlaps(2).begin(),
+                           net.memoryOverlaps(2).end()) ==
+          std::vector<int>{1, -1});
+    net.learnPattern(p1);  // duplicato di p1
+    net.learnPattern({1, 1, -1});
+    CHECK(net.memoryOverlaps(3)[0] == 3);
+    CHECK(net.nearDuplicates(3) ==
+          std::vector<std::pair<std::size_t, std::size_t>>{{0, 3}});
+    // a distanza di Hamming <= 1
+    CHECK(net.nearDuplicates(1).size() == 5);
+    CHECK_THROWS_WITH_AS(net.memoryOverlaps(5), "Index is out of bounds!",
+                         std::runtime_error);
+  }
+  SUBCASE("the cache is rebuilt by loadMemory") {
+    const abc::TempFile file("modern_gram.bin");
+    net.save(file.path());
+    abc::ModernHopfieldNetwork loaded;
+    loaded.loadMemory(file.path());
+    CHECK(loaded.totalSystemEnergy() ==
+          doctest::Approx(net.totalSystemEnergy()));
+  }
 }
 TEST_CASE("restorePattern_withAnnealing converges to a stable pattern") {
   abc::ModernHopfieldNetwork net(5);
@@ -101,4 +467,92 @@ TEST_CASE("restorePattern_withAnnealing converges to a stable pattern") {
   }
 
   CHECK(corrupted == pattern);  // convergenza al pattern originale
-}
\ No newline at end of file
+}
+TEST_CASE("restorePattern_withAnnealing - a linear schedule down to zero") {
+  // t0 = 0.45 e passo 0.45: T = 0 dal secondo sweep, inverse = +inf
+  const std::size_t dim{64};
+  std::mt19937 gen(29);
+  std::uniform_int_distribution<int> coin(0, 1);
+  abc::ModernHopfieldNetwork net(static_cast<int>(dim));
+  std::vector<std::vector<int>> stored(3, std::vector<int>(dim));
+  for (auto& pattern : stored) {
+    for (auto& v : pattern) v = coin(gen) ? 1 : -1;
+    net.learnPattern(pattern);
+  }
+  net.setTemp0(0.1);
+  net.setCoolingSchedule(abc::LinearCooling{0.45});
+  CHECK(net.CoolingSchedule(1) == 0.0);
+
+  auto run = [&](std::vector<int>& query) {
+    bool done = false;
+    for (int n = 0; n < 6; ++n) {
+      done = net.restorePattern_withAnnealing(query, n);
+      CHECK_FALSE(std::isnan(net.energyPerState(query, n)));
+      CHECK_FALSE(std::isnan(net.logEnergyPerState(query, n)));
+    }
+    return done;
+  };
+
+  std::vector<int> query = stored[1];
+  for (std::size_t i = 0; i < dim; i += 10) query[i] = -query[i];
+  std::vector<int> fastQuery = query;
+  CHECK(run(query));
+  CHECK(query == stored[1]);
+
+  SUBCASE("float exp path") {
+    net.setFloatExp(true);
+    CHECK(run(fastQuery));
+    CHECK(fastQuery == stored[1]);
+  }
+}
+TEST_CASE("probability - the same seed gives the same decisions") {
+  abc::ModernHopfieldNetwork net(5);
+  std::vector<bool> first;
+  std::vector<bool> second;
+  abc::UniformStream uniform(11);
+  for (int i = 0; i < 50; ++i) {
+    first.push_back(net.probability(2.0, 3.0, uniform));
+  }
+  uniform.seed(11);
+  for (int i = 0; i < 50; ++i) {
+    second.push_back(net.probability(2.0, 3.0, uniform));
+  }
+  CHECK(first == second);
+  CHECK(std::count(first.begin(), first.end(), true) > 0);
+  CHECK(std::count(first.begin(), first.end(), false) > 0);
+}
+TEST_CASE("Testing save and loadMemory") {
+  abc::ModernHopfieldNetwork net(4);
+  net.learnPattern({1, -1, 1, 1});
+  net.learnPattern({-1, -1, 1, -1});
+  const abc::TempFile file("modern_memory.bin");
+  net.save(file.path());
+
+  abc::ModernHopfieldNetwork loaded;
+  loaded.loadMemory(file.path());
+  // le memorie restano solo impacchettate: il file non resta mappato
+  CHECK_FALSE(loaded.getMatrix().isMapped());
+  CHECK(loaded.neurons() == 4);
+  CHECK(loaded.getMatrix().size() == 2);
+  CHECK(loaded.getMatrix().getMatrix()[1] == std::vector<int>{-1, -1, 1, -1});
+
+  loaded.learnPattern({1, 1, 1, 1});
+  CHECK(loaded.getMatrix().size() == 3);
+
+  SUBCASE("text format") {
+    const abc::TempFile text("modern_memory.txt");
+    loaded.save(text.path(), abc::FileFormat::Text);
+    abc::ModernHopfieldNetwork reloaded;
+    reloaded.loadMemory(text.path());
+    CHECK(reloaded.getMatrix().getMatrix()[2] == std::vector<int>{1, 1, 1, 1});
+  }
+  SUBCASE("only +1 and -1 are stored") {
+    CHECK_THROWS_WITH_AS(loaded.learnPattern({1, 0, 1, 1}),
+                         "Patterns must contain only +1 and -1!",
+                         std::runtime_error);
+    CHECK_THROWS_WITH_AS(loaded.learnPattern({1, 1}),
+                         "Vector and matrix sizes do not match!",
+                         std::runtime_error);
+    CHECK(loaded.getMatrix().size() == 3);
+  }
+}
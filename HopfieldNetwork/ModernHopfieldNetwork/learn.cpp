@@ -38,16 +38,18 @@ int main() {
     
     std::cout << "LOADING STARTED\n" << std::flush;
 
+    // pattern gia' ridotti delle esecuzioni precedenti
+    const abc::PatternCache cache("PatternCache");
     for (const auto& path : images) {
       std::cout << "working on:\t " << path << '\n';
-      abc::HopfieldImagePattern pattern(path, static_cast<unsigned int>(dimension));
-      pattern.adaptImage_withBilinearInterpolation();
+      abc::HopfieldImagePattern pattern(
+          path, static_cast<unsigned int>(dimension), cache);
 
       net.learnPattern(pattern.getPattern());
     }
 
 
-    net.save("ModernMatrixValues.txt");
+    net.save("ModernMatrixValues.bin");
     std::cout << "LEARNING COMPLETE\n" << std::flush;
 
   } catch (std::exception const& e) {
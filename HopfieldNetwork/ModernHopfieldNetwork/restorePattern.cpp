@@ -24,7 +24,7 @@ int main() {
     std::cin >> filePath;
 
     if (filePath == "#") {
-      filePath = "ModernMatrixValues.txt";
+      filePath = "ModernMatrixValues.bin";
     }
     abc::ModernHopfieldNetwork net;
     std::cout << "loading memory...\n";
@@ -42,8 +42,8 @@ int main() {
       filePath = "ModernHopfieldNetwork/images/orecchino.png";
     }
 
-    unsigned int patternSize{static_cast<unsigned int>(
-        std::sqrt(net.getMatrix().getMatrix()[0].size()))};
+    unsigned int patternSize{
+        static_cast<unsigned int>(std::sqrt(net.neurons()))};
 
     std::cout << patternSize << "\n";
     abc::HopfieldImagePattern pattern(filePath, patternSize);
@@ -182,8 +182,8 @@ int main() {
         if (!converged) {
           converged =
               net.restorePattern_withAnnealing(pattern.elaboratePattern(), n);
-          updateTexture.update(pattern.printPattern());
-          updateSprite.setTexture(updateTexture);
+          // pixel scritti nella texture esistente, senza sf::Image per frame
+          pattern.updateTexture(updateTexture);
 
           assert(net.energyPerState(pattern.getPattern(), n) <= Energy);
           Entext.setString("Energy: " + std::to_string(net.energyPerState(